@@ -0,0 +1,311 @@
+// Measures how many generations per second GoLGrid_evolve simulates, on random soups and on the active cells of pattern files, in grids of several sizes
+// GoLGrid_evolve only processes the columns and rows within the population rectangle of the grid, so the time per generation should follow the area of that
+// rectangle rather than the grid size. Both areas are reported, to show where this pays off and where the fixed cost per generation dominates
+// Build it with the same options as destroy.c, for example:
+// gcc bench_evolve.c -lm -o bench_evolve256 -std=c99 -O3 -Wall -Wextra -Wno-unused-function -Werror -fno-tree-loop-distribute-patterns -march=native
+// Where hardware performance counters are available, instructions per cycle and L1 data cache misses per generation are also reported
+
+// Makes the syscall function used by perfcount.c available in a strict C99 build
+#define _POSIX_C_SOURCE 200112L
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <memory.h>
+#include <math.h>
+#include <time.h>
+#include <string.h>
+#include <stdio.h>
+
+#ifdef __SSE2__
+	#include <immintrin.h>
+#endif
+
+#include "lib.c"
+#include "rect.c"
+#include "randomarray.c"
+#include "golgrid.c"
+#include "celllist.c"
+#include "gridmisc.c"
+#include "perfcount.c"
+
+#define MAX_GRID_SIZE 512
+#define MAX_FILE_SIZE 65536
+#define GENS_PER_RUN 1024
+#define MIN_SECONDS_PER_TEST 0.5
+#define SOUP_DENSITY 0.5
+#define BENCH_SEED_1 0x2545f4914f6cdd1du
+#define BENCH_SEED_2 0x9e3779b97f4a7c15u
+
+#define GRID_SIZE_CNT 4
+static const s32 grid_size [GRID_SIZE_CNT] = {64, 128, 256, 512};
+
+#define SOUP_CNT 3
+static const s32 soup_size [SOUP_CNT] = {16, 32, 64};
+
+static GoLGrid start_grid [GRID_SIZE_CNT];
+static GoLGrid gen_grid_1 [GRID_SIZE_CNT];
+static GoLGrid gen_grid_2 [GRID_SIZE_CNT];
+
+// All patterns are made in this grid first, with the pattern centered on (0, 0), and then copied to the grids of each size
+static GoLGrid source;
+
+static PerfCounters perf;
+
+static int create_grids (void)
+{
+	Rect grid_rect;
+	Rect_make (&grid_rect, -(MAX_GRID_SIZE / 2), -(MAX_GRID_SIZE / 2), MAX_GRID_SIZE, MAX_GRID_SIZE);
+	if (!GoLGrid_create (&source, &grid_rect))
+		return FALSE;
+	
+	int size_ix;
+	for (size_ix = 0; size_ix < GRID_SIZE_CNT; size_ix++)
+	{
+		Rect_make (&grid_rect, -(grid_size [size_ix] / 2), -(grid_size [size_ix] / 2), grid_size [size_ix], grid_size [size_ix]);
+		if (!GoLGrid_create (&start_grid [size_ix], &grid_rect) || !GoLGrid_create (&gen_grid_1 [size_ix], &grid_rect) || !GoLGrid_create (&gen_grid_2 [size_ix], &grid_rect))
+			return FALSE;
+	}
+	
+	return TRUE;
+}
+
+static void make_soup (s32 size, int soup_ix)
+{
+	random_u64_set_seed (BENCH_SEED_1 + (u64) soup_ix, BENCH_SEED_2, FALSE);
+	GoLGrid_clear_noinline (&source);
+	
+	u64 threshold = (u64) (SOUP_DENSITY * 18446744073709551615.0);
+	
+	s32 x;
+	s32 y;
+	for (y = -(size / 2); y < size - (size / 2); y++)
+		for (x = -(size / 2); x < size - (size / 2); x++)
+			if (random_u64 () < threshold)
+				GoLGrid_set_cell_on (&source, x, y);
+}
+
+// Reads the cells in state 1 of a LifeHistory file, which are the active pattern and the still lifes of a problem. Other states are ignored
+static int load_pattern_file (const char *filename)
+{
+	static char file_buf [MAX_FILE_SIZE + 1];
+	
+	FILE *pattern_file = fopen (filename, "r");
+	if (pattern_file == NULL)
+	{
+		fprintf (stderr, "Failed to open pattern file %s\n", filename);
+		return FALSE;
+	}
+	
+	s32 file_size = fread (file_buf, 1, MAX_FILE_SIZE, pattern_file);
+	fclose (pattern_file);
+	
+	if (file_size >= MAX_FILE_SIZE)
+	{
+		fprintf (stderr, "Pattern file %s is too large\n", filename);
+		return FALSE;
+	}
+	
+	file_buf [file_size] = '\0';
+	
+	s32 start_ix = 0;
+	int skip = FALSE;
+	while (TRUE)
+	{
+		char c = file_buf [start_ix];
+		
+		if (c == '\0')
+			break;
+		else if (c == '#' || c == 'x')
+			skip = TRUE;
+		else if (c == '\n' || c == '\r')
+			skip = FALSE;
+		else if (!skip)
+			break;
+		
+		start_ix++;
+	}
+	
+	if (!GoLGrid_parse_life_history_simple (&file_buf [start_ix], -(MAX_GRID_SIZE / 2), -(MAX_GRID_SIZE / 2), &source))
+	{
+		fprintf (stderr, "Illegal pattern file %s\n", filename);
+		return FALSE;
+	}
+	
+	// Move the pattern so that it is centered on (0, 0)
+	Rect bb;
+	if (!GoLGrid_get_bounding_box (&source, &bb))
+		return TRUE;
+	
+	GoLGrid *temp = &gen_grid_1 [GRID_SIZE_CNT - 1];
+	GoLGrid_copy_noinline (&source, temp);
+	GoLGrid_clear_noinline (&source);
+	
+	s32 x;
+	s32 y;
+	int find_first = TRUE;
+	while (GoLGrid_find_next_on_cell_noinline (temp, find_first, &x, &y))
+	{
+		GoLGrid_set_cell_on (&source, x - (bb.left_x + (bb.width / 2)), y - (bb.top_y + (bb.height / 2)));
+		find_first = FALSE;
+	}
+	
+	return TRUE;
+}
+
+// Returns FALSE if the pattern doesn't fit in the grid
+static int copy_source_to_grid (GoLGrid *gg)
+{
+	GoLGrid_clear_noinline (gg);
+	
+	s32 x;
+	s32 y;
+	int find_first = TRUE;
+	while (GoLGrid_find_next_on_cell_noinline (&source, find_first, &x, &y))
+	{
+		if (!GoLGrid_set_cell_on (gg, x, y))
+			return FALSE;
+		
+		find_first = FALSE;
+	}
+	
+	return TRUE;
+}
+
+// The evolution loop is kept in a function that is never inlined, so that GCC vectorizes GoLGrid_evolve the same way as in the search
+// If rect_cell_sum is not NULL, the number of cells within the population rectangle of each generation is added to it, counting whole 64-bit columns, as those are
+// what GoLGrid_evolve processes
+static __not_inline void evolve_generations (GoLGrid *gen_1, GoLGrid *gen_2, s32 gen_cnt, double *rect_cell_sum)
+{
+	s32 gen_ix;
+	for (gen_ix = 0; gen_ix < gen_cnt; gen_ix++)
+	{
+		if (rect_cell_sum && gen_1->pop_x_on < gen_1->pop_x_off)
+			*rect_cell_sum += 64.0 * (double) (((gen_1->pop_x_off + 63) >> 6) - (gen_1->pop_x_on >> 6)) * (double) (gen_1->pop_y_off - gen_1->pop_y_on);
+		
+		GoLGrid_evolve (gen_1, gen_2);
+		
+		GoLGrid *temp = gen_1;
+		gen_1 = gen_2;
+		gen_2 = temp;
+	}
+}
+
+// Formats the instructions per cycle and the L1 data cache misses per generation, or "-" if the counters for them are not available
+static void format_perf_columns (const PerfCounterValues *start, const PerfCounterValues *end, double gens, char *ipc_text, char *miss_text)
+{
+	u64 cycles = end->value [PERF_COUNTER_CYCLES] - start->value [PERF_COUNTER_CYCLES];
+	if (PerfCounters_is_available (&perf, PERF_COUNTER_CYCLES) && PerfCounters_is_available (&perf, PERF_COUNTER_INSTRUCTIONS) && cycles != 0)
+		sprintf (ipc_text, "%.2f", (double) (end->value [PERF_COUNTER_INSTRUCTIONS] - start->value [PERF_COUNTER_INSTRUCTIONS]) / (double) cycles);
+	else
+		sprintf (ipc_text, "-");
+	
+	if (PerfCounters_is_available (&perf, PERF_COUNTER_L1D_MISSES))
+		sprintf (miss_text, "%.2f", (double) (end->value [PERF_COUNTER_L1D_MISSES] - start->value [PERF_COUNTER_L1D_MISSES]) / gens);
+	else
+		sprintf (miss_text, "-");
+}
+
+static void time_evolution (const char *pattern_name)
+{
+	int size_ix;
+	for (size_ix = 0; size_ix < GRID_SIZE_CNT; size_ix++)
+	{
+		if (!copy_source_to_grid (&start_grid [size_ix]))
+			continue;
+		
+		// One run without timing, to get the population rectangle statistics and the final population
+		double rect_cell_sum = 0.0;
+		GoLGrid_copy_noinline (&start_grid [size_ix], &gen_grid_1 [size_ix]);
+		evolve_generations (&gen_grid_1 [size_ix], &gen_grid_2 [size_ix], GENS_PER_RUN, &rect_cell_sum);
+		
+		u64 final_pop = GoLGrid_get_population_noinline ((GENS_PER_RUN % 2) == 0 ? &gen_grid_1 [size_ix] : &gen_grid_2 [size_ix]);
+		
+		s64 run_cnt = 0;
+		double seconds = 0.0;
+		
+		PerfCounterValues perf_start;
+		PerfCounterValues perf_end;
+		PerfCounters_read (&perf, &perf_start);
+		
+		double start_time = get_cpu_seconds ();
+		
+		while (seconds < MIN_SECONDS_PER_TEST)
+		{
+			GoLGrid_copy_noinline (&start_grid [size_ix], &gen_grid_1 [size_ix]);
+			evolve_generations (&gen_grid_1 [size_ix], &gen_grid_2 [size_ix], GENS_PER_RUN, NULL);
+			
+			run_cnt++;
+			seconds = get_cpu_seconds () - start_time;
+		}
+		
+		PerfCounters_read (&perf, &perf_end);
+		
+		double gens = (double) run_cnt * (double) GENS_PER_RUN;
+		
+		char ipc_text [32];
+		char miss_text [32];
+		format_perf_columns (&perf_start, &perf_end, gens, ipc_text, miss_text);
+		double grid_cells = (double) grid_size [size_ix] * (double) grid_size [size_ix];
+		double mean_rect_cells = rect_cell_sum / (double) GENS_PER_RUN;
+		
+		printf ("%-16s %5d %6" PRIu64 " %6" PRIu64 " %9.0f %6.1f%% %12.0f %10.1f %10.1f %9.1f %5s %10s\n", pattern_name, grid_size [size_ix],
+				GoLGrid_get_population_noinline (&start_grid [size_ix]), final_pop, mean_rect_cells, 100.0 * mean_rect_cells / grid_cells, gens / seconds,
+				1e-6 * gens * grid_cells / seconds, 1e-6 * gens * mean_rect_cells / seconds, 1e9 * seconds / gens, ipc_text, miss_text);
+		
+		fflush (stdout);
+	}
+}
+
+static void print_usage (void)
+{
+	fprintf (stderr, "USAGE:   bench_evolve [<pattern file> ...]\n");
+	fprintf (stderr, "Times the evolution of random soups and of the active cells in the pattern files,\n");
+	fprintf (stderr, "or in demonoid.rle if no pattern files are given\n");
+}
+
+int main (int argc, const char *const *argv)
+{
+	if (!verify_cpu_type ())
+		return EXIT_FAILURE;
+	
+	if (argc > 1 && argv [1][0] == '-')
+	{
+		print_usage ();
+		return EXIT_FAILURE;
+	}
+	
+	if (!create_grids ())
+		return EXIT_FAILURE;
+	
+	PerfCounters_create (&perf, TRUE);
+	
+	printf ("Evolution benchmark, %d-bit vectors, %d generations per run\n", 8 * PREFERRED_VECTOR_BYTE_SIZE, GENS_PER_RUN);
+	printf ("Cell updates are counted both for the whole grid and for the population rectangle of each generation\n");
+	printf ("%-16s %5s %6s %6s %9s %7s %12s %10s %10s %9s %5s %10s\n", "pattern", "grid", "pop", "final", "rect", "rect%", "gens/s", "Mgrid/s", "Mrect/s", "ns/gen", "IPC",
+			"L1Dmiss/gen");
+	
+	int soup_ix;
+	for (soup_ix = 0; soup_ix < SOUP_CNT; soup_ix++)
+	{
+		char name [32];
+		sprintf (name, "soup %dx%d", soup_size [soup_ix], soup_size [soup_ix]);
+		
+		make_soup (soup_size [soup_ix], soup_ix);
+		time_evolution (name);
+	}
+	
+	if (argc == 1)
+	{
+		if (load_pattern_file ("demonoid.rle"))
+			time_evolution ("demonoid.rle");
+	}
+	
+	int arg_ix;
+	for (arg_ix = 1; arg_ix < argc; arg_ix++)
+		if (load_pattern_file (argv [arg_ix]))
+			time_evolution (argv [arg_ix]);
+	
+	return EXIT_SUCCESS;
+}
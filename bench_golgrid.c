@@ -0,0 +1,437 @@
+// Times the GoLGrid operations one at a time, so that a change to a single kernel can be measured on its own
+// Each operation is run on a full grid, a grid where only a small area is populated, and a 64 cells wide grid, with random patterns of a few densities
+// Build it with the same options as destroy.c, to get the version for 128-bit, 256-bit or 512-bit vectors, for example:
+// gcc bench_golgrid.c -lm -o bench_golgrid256 -std=c99 -O3 -Wall -Wextra -Wno-unused-function -Werror -fno-tree-loop-distribute-patterns -march=native
+
+#include <stdlib.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <memory.h>
+#include <math.h>
+#include <time.h>
+#include <string.h>
+#include <stdio.h>
+
+#ifdef __SSE2__
+	#include <immintrin.h>
+#endif
+
+#include "lib.c"
+#include "rect.c"
+#include "randomarray.c"
+#include "golgrid.c"
+
+#define GRID_SIZE 256
+#define SPARSE_AREA_SIZE 32
+#define MIN_SECONDS_PER_TEST 0.2
+#define BENCH_SEED_1 0x2545f4914f6cdd1du
+#define BENCH_SEED_2 0x9e3779b97f4a7c15u
+
+enum
+{
+	OP_EVOLVE,
+	OP_BLEED_4,
+	OP_BLEED_8,
+	OP_OR,
+	OP_AND,
+	OP_SUBTRACT,
+	OP_COPY,
+	OP_IS_SUBSET,
+	OP_IS_EQUAL,
+	OP_ARE_DISJOINT,
+	OP_GET_HASH,
+	OP_GET_POPULATION,
+	OP_FLIP_HORIZONTALLY,
+	OP_FLIP_VERTICALLY,
+	OP_FLIP_DIAGONALLY,
+	OP_FIND_NEXT_ON_CELL,
+	OP_CNT
+};
+
+static const char *const op_name [OP_CNT] = {"evolve", "bleed_4", "bleed_8", "or", "and", "subtract", "copy", "is_subset", "is_equal", "are_disjoint", "get_hash",
+		"get_population", "flip_horizontally", "flip_vertically", "flip_diagonally", "find_next_on_cell"};
+
+// The number of grids that each operation reads or writes, used to estimate the memory bandwidth
+static const int op_grid_cnt [OP_CNT] = {2, 2, 2, 2, 3, 2, 2, 2, 2, 2, 1, 1, 2, 2, 2, 1};
+
+enum
+{
+	LAYOUT_FULL,
+	LAYOUT_SPARSE,
+	LAYOUT_64_WIDE,
+	LAYOUT_CNT
+};
+
+static const char *const layout_name [LAYOUT_CNT] = {"full", "sparse", "64-wide"};
+
+#define DENSITY_CNT 3
+static const double density [DENSITY_CNT] = {0.05, 0.2, 0.5};
+
+// The grids used by one test. src_2 is another random pattern in the same area as src_1, and ref is what src_1 is compared to by the operation being timed, chosen
+// so that the comparison has to look at the whole population area instead of stopping at the first difference. flip_src is src_1 moved to the top-left corner,
+// which the flip operations require
+typedef struct
+{
+	GoLGrid src_1;
+	GoLGrid src_2;
+	GoLGrid ref;
+	GoLGrid flip_src;
+	GoLGrid dst;
+	RandomDataArray rda;
+} BenchGrids;
+
+static int create_bench_grids (BenchGrids *bg, s32 width, s32 height)
+{
+	Rect grid_rect;
+	Rect_make (&grid_rect, 0, 0, width, height);
+	
+	return (GoLGrid_create (&bg->src_1, &grid_rect) && GoLGrid_create (&bg->src_2, &grid_rect) && GoLGrid_create (&bg->ref, &grid_rect) &&
+			GoLGrid_create (&bg->flip_src, &grid_rect) && GoLGrid_create (&bg->dst, &grid_rect) && RandomDataArray_create (&bg->rda, (u64) (width >> 6) * (u64) height));
+}
+
+static void free_bench_grids (BenchGrids *bg)
+{
+	GoLGrid_free (&bg->src_1);
+	GoLGrid_free (&bg->src_2);
+	GoLGrid_free (&bg->ref);
+	GoLGrid_free (&bg->flip_src);
+	GoLGrid_free (&bg->dst);
+	RandomDataArray_free (&bg->rda);
+}
+
+static void fill_random (GoLGrid *gg, const Rect *area, double fill_density)
+{
+	GoLGrid_clear_noinline (gg);
+	
+	u64 threshold = (u64) (fill_density * 18446744073709551615.0);
+	
+	s32 x;
+	s32 y;
+	for (y = area->top_y; y < area->top_y + area->height; y++)
+		for (x = area->left_x; x < area->left_x + area->width; x++)
+			if (random_u64 () < threshold)
+				GoLGrid_set_cell_on (gg, x, y);
+}
+
+static void prepare_test (BenchGrids *bg, int op, const Rect *area, double fill_density)
+{
+	fill_random (&bg->src_1, area, fill_density);
+	fill_random (&bg->src_2, area, fill_density);
+	
+	if (op == OP_IS_SUBSET)
+	{
+		GoLGrid_copy_noinline (&bg->src_1, &bg->ref);
+		GoLGrid_or_noinline (&bg->ref, &bg->src_2);
+	}
+	else if (op == OP_ARE_DISJOINT)
+	{
+		GoLGrid_copy_noinline (&bg->src_2, &bg->ref);
+		GoLGrid_subtract_noinline (&bg->ref, &bg->src_1);
+	}
+	else
+		GoLGrid_copy_noinline (&bg->src_1, &bg->ref);
+	
+	GoLGrid_clear_noinline (&bg->flip_src);
+	
+	Rect bb;
+	GoLGrid_get_bounding_box (&bg->src_1, &bb);
+	
+	s32 x;
+	s32 y;
+	int find_first = TRUE;
+	while (GoLGrid_find_next_on_cell_noinline (&bg->src_1, find_first, &x, &y))
+	{
+		GoLGrid_set_cell_on (&bg->flip_src, x - bb.left_x, y - bb.top_y);
+		find_first = FALSE;
+	}
+	
+	GoLGrid_copy_noinline (&bg->src_1, &bg->dst);
+}
+
+// The loops are kept inside a function that is never inlined, so that GCC vectorizes the inlined GoLGrid functions the same way as in the search
+static __not_inline u64 run_op_full (BenchGrids *bg, int op, s64 iter_cnt)
+{
+	u64 sum = 0;
+	s64 iter_ix;
+	s32 x;
+	s32 y;
+	
+	switch (op)
+	{
+		case OP_EVOLVE:
+			for (iter_ix = 0; iter_ix < iter_cnt; iter_ix++)
+				GoLGrid_evolve (&bg->src_1, &bg->dst);
+			break;
+		case OP_BLEED_4:
+			for (iter_ix = 0; iter_ix < iter_cnt; iter_ix++)
+				GoLGrid_bleed_4 (&bg->src_1, &bg->dst);
+			break;
+		case OP_BLEED_8:
+			for (iter_ix = 0; iter_ix < iter_cnt; iter_ix++)
+				GoLGrid_bleed_8 (&bg->src_1, &bg->dst);
+			break;
+		case OP_OR:
+			for (iter_ix = 0; iter_ix < iter_cnt; iter_ix++)
+				GoLGrid_or (&bg->dst, &bg->src_2);
+			break;
+		case OP_AND:
+			for (iter_ix = 0; iter_ix < iter_cnt; iter_ix++)
+				GoLGrid_and (&bg->src_1, &bg->src_2, &bg->dst);
+			break;
+		case OP_SUBTRACT:
+			for (iter_ix = 0; iter_ix < iter_cnt; iter_ix++)
+				GoLGrid_subtract (&bg->dst, &bg->src_2);
+			break;
+		case OP_COPY:
+			for (iter_ix = 0; iter_ix < iter_cnt; iter_ix++)
+				GoLGrid_copy (&bg->src_1, &bg->dst);
+			break;
+		case OP_IS_SUBSET:
+			for (iter_ix = 0; iter_ix < iter_cnt; iter_ix++)
+				sum += (u64) GoLGrid_is_subset (&bg->src_1, &bg->ref);
+			break;
+		case OP_IS_EQUAL:
+			for (iter_ix = 0; iter_ix < iter_cnt; iter_ix++)
+				sum += (u64) GoLGrid_is_equal (&bg->src_1, &bg->ref);
+			break;
+		case OP_ARE_DISJOINT:
+			for (iter_ix = 0; iter_ix < iter_cnt; iter_ix++)
+				sum += (u64) GoLGrid_are_disjoint (&bg->src_1, &bg->ref);
+			break;
+		case OP_GET_HASH:
+			for (iter_ix = 0; iter_ix < iter_cnt; iter_ix++)
+				sum += GoLGrid_get_hash (&bg->src_1, &bg->rda);
+			break;
+		case OP_GET_POPULATION:
+			for (iter_ix = 0; iter_ix < iter_cnt; iter_ix++)
+				sum += GoLGrid_get_population (&bg->src_1);
+			break;
+		case OP_FLIP_HORIZONTALLY:
+			for (iter_ix = 0; iter_ix < iter_cnt; iter_ix++)
+				GoLGrid_flip_horizontally (&bg->flip_src, &bg->dst);
+			break;
+		case OP_FLIP_VERTICALLY:
+			for (iter_ix = 0; iter_ix < iter_cnt; iter_ix++)
+				GoLGrid_flip_vertically (&bg->flip_src, &bg->dst);
+			break;
+		case OP_FLIP_DIAGONALLY:
+			for (iter_ix = 0; iter_ix < iter_cnt; iter_ix++)
+				GoLGrid_flip_diagonally (&bg->flip_src, &bg->dst);
+			break;
+		case OP_FIND_NEXT_ON_CELL:
+			for (iter_ix = 0; iter_ix < iter_cnt; iter_ix++)
+			{
+				int find_first = TRUE;
+				while (GoLGrid_find_next_on_cell (&bg->src_1, find_first, &x, &y))
+				{
+					sum += (u64) (x + y);
+					find_first = FALSE;
+				}
+			}
+			break;
+	}
+	
+	return sum + GoLGrid_get_population_noinline (&bg->dst);
+}
+
+// The same as run_op_full, with the versions of the operations that only work on a grid that is 64 cells wide. Operations that have no such version return FALSE
+static __not_inline int run_op_64_wide (BenchGrids *bg, int op, s64 iter_cnt, u64 *result)
+{
+	u64 sum = 0;
+	s64 iter_ix;
+	s32 x;
+	s32 y;
+	
+	switch (op)
+	{
+		case OP_EVOLVE:
+			for (iter_ix = 0; iter_ix < iter_cnt; iter_ix++)
+				GoLGrid_evolve_64_wide (&bg->src_1, &bg->dst);
+			break;
+		case OP_BLEED_4:
+			for (iter_ix = 0; iter_ix < iter_cnt; iter_ix++)
+				GoLGrid_bleed_4_64_wide (&bg->src_1, &bg->dst);
+			break;
+		case OP_BLEED_8:
+			for (iter_ix = 0; iter_ix < iter_cnt; iter_ix++)
+				GoLGrid_bleed_8_64_wide (&bg->src_1, &bg->dst);
+			break;
+		case OP_OR:
+			for (iter_ix = 0; iter_ix < iter_cnt; iter_ix++)
+				GoLGrid_or_64_wide (&bg->dst, &bg->src_2);
+			break;
+		case OP_AND:
+			for (iter_ix = 0; iter_ix < iter_cnt; iter_ix++)
+				GoLGrid_and_64_wide (&bg->src_1, &bg->src_2, &bg->dst);
+			break;
+		case OP_SUBTRACT:
+			for (iter_ix = 0; iter_ix < iter_cnt; iter_ix++)
+				GoLGrid_subtract_64_wide (&bg->dst, &bg->src_2);
+			break;
+		case OP_COPY:
+			for (iter_ix = 0; iter_ix < iter_cnt; iter_ix++)
+				GoLGrid_copy_64_wide (&bg->src_1, &bg->dst);
+			break;
+		case OP_IS_SUBSET:
+			for (iter_ix = 0; iter_ix < iter_cnt; iter_ix++)
+				sum += (u64) GoLGrid_is_subset_64_wide (&bg->src_1, &bg->ref);
+			break;
+		case OP_IS_EQUAL:
+			for (iter_ix = 0; iter_ix < iter_cnt; iter_ix++)
+				sum += (u64) GoLGrid_is_equal_64_wide (&bg->src_1, &bg->ref);
+			break;
+		case OP_ARE_DISJOINT:
+			for (iter_ix = 0; iter_ix < iter_cnt; iter_ix++)
+				sum += (u64) GoLGrid_are_disjoint_64_wide (&bg->src_1, &bg->ref);
+			break;
+		case OP_GET_HASH:
+			for (iter_ix = 0; iter_ix < iter_cnt; iter_ix++)
+				sum += GoLGrid_get_hash_64_wide (&bg->src_1, &bg->rda);
+			break;
+		case OP_GET_POPULATION:
+			for (iter_ix = 0; iter_ix < iter_cnt; iter_ix++)
+				sum += GoLGrid_get_population_64_wide (&bg->src_1);
+			break;
+		case OP_FIND_NEXT_ON_CELL:
+			for (iter_ix = 0; iter_ix < iter_cnt; iter_ix++)
+			{
+				int find_first = TRUE;
+				while (GoLGrid_find_next_on_cell_64_wide (&bg->src_1, find_first, &x, &y))
+				{
+					sum += (u64) (x + y);
+					find_first = FALSE;
+				}
+			}
+			break;
+		default:
+			return FALSE;
+	}
+	
+	*result = sum + GoLGrid_get_population_noinline (&bg->dst);
+	return TRUE;
+}
+
+// Bytes in the population rectangle of src_1, rounded out to whole 64-bit words
+static double get_pop_rect_byte_size (const GoLGrid *gg)
+{
+	if (gg->pop_x_off <= gg->pop_x_on)
+		return 0.0;
+	
+	s32 col_cnt = ((gg->pop_x_off + 63) >> 6) - (gg->pop_x_on >> 6);
+	return 8.0 * (double) col_cnt * (double) (gg->pop_y_off - gg->pop_y_on);
+}
+
+// The results of the timed operations are written here, so that they can't be optimized away
+static volatile u64 result_sink = 0;
+
+// Doubles the iteration count until a run takes at least MIN_SECONDS_PER_TEST, and prints the time of the last run. Returns FALSE if the operation isn't available
+static int time_op (BenchGrids *bg, int op, int layout, double fill_density)
+{
+	s64 iter_cnt = 1;
+	double seconds = 0.0;
+	u64 result = 0;
+	
+	while (TRUE)
+	{
+		double start_time = get_cpu_seconds ();
+		
+		if (layout == LAYOUT_64_WIDE)
+		{
+			if (!run_op_64_wide (bg, op, iter_cnt, &result))
+				return FALSE;
+		}
+		else
+			result = run_op_full (bg, op, iter_cnt);
+		
+		seconds = get_cpu_seconds () - start_time;
+		if (seconds >= MIN_SECONDS_PER_TEST)
+			break;
+		
+		iter_cnt *= 2;
+	}
+	
+	double ns_per_op = 1e9 * seconds / (double) iter_cnt;
+	double gb_per_s = ((double) op_grid_cnt [op] * get_pop_rect_byte_size (&bg->src_1)) / ns_per_op;
+	
+	printf ("%-18s %-8s %5.2f %7" PRIu64 " %12.1f %10.2f\n", op_name [op], layout_name [layout], fill_density, GoLGrid_get_population_noinline (&bg->src_1), ns_per_op, gb_per_s);
+	fflush (stdout);
+	
+	result_sink ^= result;
+	return TRUE;
+}
+
+static void print_usage (void)
+{
+	fprintf (stderr, "USAGE:   bench_golgrid [<operation>]\n");
+	fprintf (stderr, "Times all GoLGrid operations, or only the named one\n");
+}
+
+int main (int argc, const char *const *argv)
+{
+	if (!verify_cpu_type ())
+		return EXIT_FAILURE;
+	
+	int only_op = -1;
+	if (argc > 2)
+	{
+		print_usage ();
+		return EXIT_FAILURE;
+	}
+	
+	if (argc == 2)
+	{
+		int op;
+		for (op = 0; op < OP_CNT; op++)
+			if (strcmp (argv [1], op_name [op]) == 0)
+				only_op = op;
+		
+		if (only_op < 0)
+		{
+			fprintf (stderr, "Unknown operation %s\n", argv [1]);
+			print_usage ();
+			return EXIT_FAILURE;
+		}
+	}
+	
+	BenchGrids full_grids;
+	BenchGrids wide_64_grids;
+	if (!create_bench_grids (&full_grids, GRID_SIZE, GRID_SIZE) || !create_bench_grids (&wide_64_grids, 64, GRID_SIZE))
+		return EXIT_FAILURE;
+	
+	printf ("GoLGrid benchmark, %d-bit vectors, %dx%d grid\n", 8 * PREFERRED_VECTOR_BYTE_SIZE, GRID_SIZE, GRID_SIZE);
+	printf ("%-18s %-8s %5s %7s %12s %10s\n", "operation", "layout", "dens", "pop", "ns/op", "GB/s");
+	
+	int op;
+	for (op = 0; op < OP_CNT; op++)
+	{
+		if (only_op >= 0 && op != only_op)
+			continue;
+		
+		int layout;
+		for (layout = 0; layout < LAYOUT_CNT; layout++)
+		{
+			BenchGrids *bg = (layout == LAYOUT_64_WIDE ? &wide_64_grids : &full_grids);
+			
+			Rect area;
+			if (layout == LAYOUT_SPARSE)
+				Rect_make (&area, (GRID_SIZE - SPARSE_AREA_SIZE) / 2, (GRID_SIZE - SPARSE_AREA_SIZE) / 2, SPARSE_AREA_SIZE, SPARSE_AREA_SIZE);
+			else
+				Rect_make (&area, 0, 0, bg->src_1.grid_rect.width, bg->src_1.grid_rect.height);
+			
+			// Every test starts from the same seed, so its patterns don't depend on which other tests are run
+			int density_ix;
+			for (density_ix = 0; density_ix < DENSITY_CNT; density_ix++)
+			{
+				random_u64_set_seed (BENCH_SEED_1 + (u64) density_ix, BENCH_SEED_2, FALSE);
+				prepare_test (bg, op, &area, density [density_ix]);
+				
+				if (!time_op (bg, op, layout, density [density_ix]))
+					break;
+			}
+		}
+	}
+	
+	free_bench_grids (&full_grids);
+	free_bench_grids (&wide_64_grids);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,226 @@
+// An approximate set of u64 keys that uses a fixed amount of memory, implemented as a cuckoo filter with buckets of CUCKOOFILTER_U64_BUCKET_SIZE 16-bit fingerprints
+// A key can't be 0, and keys are expected to be good hash values already. The lowest bits of the key select the first bucket and the highest 16 bits are the fingerprint
+// A key that was never stored is reported as present with a probability of about (2 * CUCKOOFILTER_U64_BUCKET_SIZE * filled part / 65535)
+// A key that was stored is always reported as present, unless its fingerprint was dropped to make room for another one. This only happens when the filter is close to
+// full, and the number of such cases is counted in dropped_cnt
+
+#define CUCKOOFILTER_U64_BUCKET_SIZE 4
+#define CUCKOOFILTER_U64_MAX_KICKS 256
+#define CUCKOOFILTER_U64_MAX_FILLED_PART 0.95
+
+typedef struct
+{
+	u64 bucket_cnt;
+	u64 max_used_capacity;
+	u64 used_capacity;
+	u64 dropped_cnt;
+	u16 *fingerprint;
+} CuckooFilter_u64;
+
+static __may_inline void CuckooFilter_u64_preinit (CuckooFilter_u64 *cf)
+{
+	if (!cf)
+		return (void) ffsc (__func__);
+	
+	cf->bucket_cnt = 0;
+	cf->max_used_capacity = 0;
+	cf->used_capacity = 0;
+	cf->dropped_cnt = 0;
+	cf->fingerprint = NULL;
+}
+
+static __not_inline void CuckooFilter_u64_free (CuckooFilter_u64 *cf)
+{
+	if (!cf)
+		return (void) ffsc (__func__);
+	
+	if (cf->fingerprint)
+		free (cf->fingerprint);
+	
+	CuckooFilter_u64_preinit (cf);
+}
+
+static __not_inline void CuckooFilter_u64_clear (CuckooFilter_u64 *cf)
+{
+	if (!cf || !cf->fingerprint)
+		return (void) ffsc (__func__);
+	
+	cf->used_capacity = 0;
+	cf->dropped_cnt = 0;
+	memset (cf->fingerprint, 0, cf->bucket_cnt * CUCKOOFILTER_U64_BUCKET_SIZE * sizeof (u16));
+}
+
+// The filter gets the largest power of two number of buckets that fits in max_memory_size bytes
+static __not_inline int CuckooFilter_u64_create (CuckooFilter_u64 *cf, u64 max_memory_size)
+{
+	if (!cf)
+		return ffsc (__func__);
+	
+	CuckooFilter_u64_preinit (cf);
+	
+	u64 bucket_byte_size = CUCKOOFILTER_U64_BUCKET_SIZE * sizeof (u16);
+	if (max_memory_size < 2 * bucket_byte_size)
+		return ffsc (__func__);
+	
+	cf->bucket_cnt = ((u64) 1) << most_significant_bit_u64 (max_memory_size / bucket_byte_size);
+	cf->max_used_capacity = (u64) (CUCKOOFILTER_U64_MAX_FILLED_PART * (double) (cf->bucket_cnt * CUCKOOFILTER_U64_BUCKET_SIZE));
+	
+	cf->fingerprint = malloc (cf->bucket_cnt * bucket_byte_size);
+	if (!cf->fingerprint)
+	{
+		fprintf (stderr, "Out of memory in %s\n", __func__);
+		CuckooFilter_u64_free (cf);
+		return FALSE;
+	}
+	
+	CuckooFilter_u64_clear (cf);
+	return TRUE;
+}
+
+static __not_inline u64 CuckooFilter_u64_memory_size (const CuckooFilter_u64 *cf)
+{
+	if (!cf)
+		return ffsc (__func__);
+	
+	return cf->bucket_cnt * CUCKOOFILTER_U64_BUCKET_SIZE * sizeof (u16);
+}
+
+static __not_inline double CuckooFilter_u64_false_positive_rate (const CuckooFilter_u64 *cf)
+{
+	if (!cf || !cf->fingerprint)
+		return (double) ffsc (__func__);
+	
+	double filled_part = (double) cf->used_capacity / (double) (cf->bucket_cnt * CUCKOOFILTER_U64_BUCKET_SIZE);
+	return 1.0 - pow (1.0 - (1.0 / 65535.0), 2.0 * CUCKOOFILTER_U64_BUCKET_SIZE * filled_part);
+}
+
+static __force_inline u16 CuckooFilter_u64_int_fingerprint (u64 key)
+{
+	u16 fingerprint = (u16) (key >> 48);
+	return (fingerprint != 0 ? fingerprint : 1);
+}
+
+// The alternate bucket only depends on the current bucket and the fingerprint, so it can be found for a fingerprint that is moved without knowing its key
+static __force_inline u64 CuckooFilter_u64_int_alt_bucket (const CuckooFilter_u64 *cf, u64 bucket_ix, u16 fingerprint)
+{
+	return (bucket_ix ^ (((u64) fingerprint) * 0xc6a4a7935bd1e995u)) & (cf->bucket_cnt - 1);
+}
+
+static __force_inline int CuckooFilter_u64_int_bucket_contains (const CuckooFilter_u64 *cf, u64 bucket_ix, u16 fingerprint)
+{
+	const u16 *bucket = cf->fingerprint + (bucket_ix * CUCKOOFILTER_U64_BUCKET_SIZE);
+	
+	int slot_ix;
+	for (slot_ix = 0; slot_ix < CUCKOOFILTER_U64_BUCKET_SIZE; slot_ix++)
+		if (bucket [slot_ix] == fingerprint)
+			return TRUE;
+	
+	return FALSE;
+}
+
+static __force_inline int CuckooFilter_u64_int_bucket_insert (CuckooFilter_u64 *cf, u64 bucket_ix, u16 fingerprint)
+{
+	u16 *bucket = cf->fingerprint + (bucket_ix * CUCKOOFILTER_U64_BUCKET_SIZE);
+	
+	int slot_ix;
+	for (slot_ix = 0; slot_ix < CUCKOOFILTER_U64_BUCKET_SIZE; slot_ix++)
+		if (bucket [slot_ix] == 0)
+		{
+			bucket [slot_ix] = fingerprint;
+			return TRUE;
+		}
+	
+	return FALSE;
+}
+
+static __force_inline int CuckooFilter_u64_contains (const CuckooFilter_u64 *cf, u64 key)
+{
+	if (!cf || !cf->fingerprint || key == 0)
+		return ffsc (__func__);
+	
+	u16 fingerprint = CuckooFilter_u64_int_fingerprint (key);
+	u64 bucket_ix = key & (cf->bucket_cnt - 1);
+	
+	return (CuckooFilter_u64_int_bucket_contains (cf, bucket_ix, fingerprint) || CuckooFilter_u64_int_bucket_contains (cf, CuckooFilter_u64_int_alt_bucket (cf, bucket_ix, fingerprint), fingerprint));
+}
+
+// Works like HashTable_u64_store for a table without data, but can't fail. If the filter is full, or no place is found for a fingerprint by moving others around,
+// a previously stored fingerprint is dropped instead
+static __force_inline int CuckooFilter_u64_store (CuckooFilter_u64 *cf, u64 key, int *was_present)
+{
+	if (was_present)
+		*was_present = FALSE;
+	
+	if (!cf || !cf->fingerprint || key == 0)
+		return ffsc (__func__);
+	
+	u16 fingerprint = CuckooFilter_u64_int_fingerprint (key);
+	u64 bucket_ix = key & (cf->bucket_cnt - 1);
+	u64 alt_bucket_ix = CuckooFilter_u64_int_alt_bucket (cf, bucket_ix, fingerprint);
+	
+	if (CuckooFilter_u64_int_bucket_contains (cf, bucket_ix, fingerprint) || CuckooFilter_u64_int_bucket_contains (cf, alt_bucket_ix, fingerprint))
+	{
+		if (was_present)
+			*was_present = TRUE;
+		
+		return TRUE;
+	}
+	
+	if (CuckooFilter_u64_int_bucket_insert (cf, bucket_ix, fingerprint) || CuckooFilter_u64_int_bucket_insert (cf, alt_bucket_ix, fingerprint))
+	{
+		cf->used_capacity++;
+		return TRUE;
+	}
+	
+	// Both buckets are full. Unless the whole filter is nearly full, move fingerprints to their alternate buckets until a free slot is found
+	// The victim slot is chosen from the key bits that are not used for the bucket index or the fingerprint
+	int kick_cnt = (cf->used_capacity < cf->max_used_capacity ? CUCKOOFILTER_U64_MAX_KICKS : 0);
+	u64 victim_bits = key >> 20;
+	
+	int kick_ix;
+	for (kick_ix = 0; kick_ix < kick_cnt; kick_ix++)
+	{
+		u16 *victim = cf->fingerprint + (bucket_ix * CUCKOOFILTER_U64_BUCKET_SIZE) + (victim_bits % CUCKOOFILTER_U64_BUCKET_SIZE);
+		victim_bits = (victim_bits >> 2) ^ (((u64) fingerprint) << 14);
+		
+		u16 moved_fingerprint = *victim;
+		*victim = fingerprint;
+		fingerprint = moved_fingerprint;
+		
+		bucket_ix = CuckooFilter_u64_int_alt_bucket (cf, bucket_ix, fingerprint);
+		if (CuckooFilter_u64_int_bucket_insert (cf, bucket_ix, fingerprint))
+		{
+			cf->used_capacity++;
+			return TRUE;
+		}
+	}
+	
+	// Overwrite a fingerprint in the bucket, the key it belonged to will be reported as not present from now on
+	cf->fingerprint [(bucket_ix * CUCKOOFILTER_U64_BUCKET_SIZE) + (victim_bits % CUCKOOFILTER_U64_BUCKET_SIZE)] = fingerprint;
+	cf->dropped_cnt++;
+	
+	return TRUE;
+}
+
+// Works like repeated calls to CuckooFilter_u64_store, but starts loading both buckets of all keys first, so that the cache misses overlap
+static __not_inline int CuckooFilter_u64_store_batch (CuckooFilter_u64 *cf, const u64 *key, int key_cnt, int *was_present)
+{
+	if (!cf || !cf->fingerprint || !key || key_cnt < 0)
+		return ffsc (__func__);
+	
+	int key_ix;
+	for (key_ix = 0; key_ix < key_cnt; key_ix++)
+	{
+		u64 bucket_ix = key [key_ix] & (cf->bucket_cnt - 1);
+		prefetch_read (cf->fingerprint + (bucket_ix * CUCKOOFILTER_U64_BUCKET_SIZE));
+		prefetch_read (cf->fingerprint + (CuckooFilter_u64_int_alt_bucket (cf, bucket_ix, CuckooFilter_u64_int_fingerprint (key [key_ix])) * CUCKOOFILTER_U64_BUCKET_SIZE));
+	}
+	
+	// Every key is handled even if storing one fails, so that all of was_present is set
+	int success = TRUE;
+	for (key_ix = 0; key_ix < key_cnt; key_ix++)
+		if (!CuckooFilter_u64_store (cf, key [key_ix], (was_present ? &was_present [key_ix] : NULL)))
+			success = FALSE;
+	
+	return success;
+}
@@ -1,11 +1,25 @@
+// Makes the monotonic clock used by get_wall_seconds, and the syscall function used by perfcount.c, available in a strict C99 build
+#define _POSIX_C_SOURCE 200112L
+#define _DEFAULT_SOURCE
+
 #include <stdlib.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <memory.h>
 #include <math.h>
 #include <time.h>
 #include <string.h>
 #include <stdio.h>
 
+#ifdef __SSE2__
+	#include <immintrin.h>
+#endif
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#endif
+
 #include "lib.c"
 #include "rect.c"
 #include "randomarray.c"
@@ -13,9 +27,17 @@
 #include "celllist.c"
 #include "gridmisc.c"
 #include "hashtable.c"
+#include "cuckoofilter.c"
 #include "store.c"
+#include "trace.c"
+#include "perfcount.c"
+
+#ifdef __INSTRUMENT
+	#include "instrument.c"
+#endif
 
-#define GG_ARRAY_CNT 48
+// The last SETUP_BATCH_SIZE grids hold the new objects of a batch of setups in add_next_object
+#define GG_ARRAY_CNT (51 + SETUP_BATCH_SIZE)
 #define GRID_SIZE 256
 #define MAX_PATTERN_SIZE (GRID_SIZE - 8)
 #define MAX_FILENAME_SIZE 256
@@ -23,11 +45,79 @@
 #define OBJECT_TYPE_CNT 13
 #define MAX_POSS_OBJECTS 262144
 #define MAX_MAX_OBJECTS 256
-#define MAX_BYTE_SEQ_SIZE (3 + 3 * MAX_MAX_OBJECTS)
+#define POOL_RECORD_SIZE 25
 #define MAX_CENSUS_OBJECTS 512
 #define MAX_GENS 32768
 #define MAX_NEW_GENS 1024
 #define COST_OFF 16384
+#define SETUP_BATCH_SIZE 32
+#define OUTCOME_SETTLED 0
+#define OUTCOME_OUT_OF_BOUNDS 1
+#define OUTCOME_LASTED_TOO_LONG 2
+#define OUTCOME_CNT 3
+#define GEN_BUCKET_CNT 16
+#define TRACE_SETUP_SAMPLE_INTERVAL 64
+#define MEMORY_LIMIT_ADAPT_PART 0.9
+#define MIN_COST_CACHE_ENTRIES 4096
+#define COST_CACHE_FILLED_PART 0.7
+#define MIN_ADAPTED_POOL_SIZE 16
+#define TIME_LIMIT_MARGIN 1.25
+#define BENCH_SEED 1
+#define BENCH_MAX_POOL_SIZE "100"
+#define BENCH_MAX_OBJECTS "5"
+
+// The phases and counters of the instrumentation in instrument.c, which is only compiled in with -D __INSTRUMENT. Otherwise the INSTRUMENT_ macros expand to nothing
+// The bytes touched by a phase are estimated from the population rectangles of the grids it reads and writes, and as one cache line for each hash table access
+#define PHASE_OTHER 0
+#define PHASE_GENS_UNTIL_STABLE 1
+#define PHASE_EARLY_AND_LATE_GRIDS 2
+#define PHASE_SETUP_AREAS 3
+#define PHASE_STARTING_POINTS 4
+#define PHASE_CANDIDATE_FILTER 5
+#define PHASE_TESTED_SETUPS 6
+#define PHASE_SETUP_CONSTRUCTION 7
+#define PHASE_SETUP_EVOLUTION 8
+#define PHASE_SETTLED_HASH 9
+#define PHASE_COST_CACHE 10
+#define PHASE_CALC_COST 11
+#define PHASE_POOL_INSERT 12
+#define PHASE_POOL_COMPACTION 13
+#define PHASE_CNT 14
+
+#define COUNTER_SETTLED_SETUPS 0
+#define COUNTER_SETTLED_GENS 1
+#define COUNTER_OUT_OF_BOUNDS_SETUPS 2
+#define COUNTER_OUT_OF_BOUNDS_GENS 3
+#define COUNTER_LASTED_TOO_LONG_SETUPS 4
+#define COUNTER_LASTED_TOO_LONG_GENS 5
+#define COUNTER_STABILIZATION_GENS 6
+#define COUNTER_TESTED_SETUP_LOOKUPS 7
+#define COUNTER_CNT 8
+
+#define CACHE_LINE_BYTES 64
+
+#ifdef __INSTRUMENT
+	static const char *const phase_name [PHASE_CNT] = {"other", "gens_until_stable", "make_early_and_late_grids", "setup_areas", "starting_points", "candidate_filter",
+			"tested_setups", "setup_construction", "run_setup_evolution", "settled_hash", "cost_cache", "calc_cost", "pool_insert", "pool_compaction"};
+	
+	static const char *const counter_name [COUNTER_CNT] = {"settled_setups", "settled_gens", "out_of_bounds_setups", "out_of_bounds_gens", "lasted_too_long_setups",
+			"lasted_too_long_gens", "stabilization_gens", "tested_setup_lookups"};
+	
+	static Instrument instrument;
+	static PerfCounters instrument_perf;
+	static PerfCounterValues instrument_perf_round_start;
+	static u64 instrument_round_start_gens;
+	
+	#define INSTRUMENT_ENTER(phase) Instrument_enter (&instrument, (phase))
+	#define INSTRUMENT_LEAVE() Instrument_leave (&instrument)
+	#define INSTRUMENT_ADD_BYTES(phase, byte_cnt) Instrument_add_bytes (&instrument, (phase), (byte_cnt))
+	#define INSTRUMENT_COUNT(counter, value) Instrument_count (&instrument, (counter), (value))
+#else
+	#define INSTRUMENT_ENTER(phase) ((void) 0)
+	#define INSTRUMENT_LEAVE() ((void) 0)
+	#define INSTRUMENT_ADD_BYTES(phase, byte_cnt) ((void) 0)
+	#define INSTRUMENT_COUNT(counter, value) ((void) 0)
+#endif
 
 
 typedef struct
@@ -51,16 +141,159 @@ typedef struct
 	double length_sq;
 } TreeEdge;
 
+// One pattern in the pool. Only the last added object is kept here, the rest of the object list is found by following parent_ix to the previous level of the PoolTree
+typedef struct
+{
+	s32 parent_ix;
+	u16 cost;
+	u8 object_type;
+	s8 left_x;
+	s8 top_y;
+} PoolTreeNode;
+
+// The pool of each round is one level of the tree, and level 0 only has a node for the empty object list. A level is never changed after it is made, so the pools of all
+// rounds share the object lists they have in common
+typedef struct
+{
+	int level_cnt;
+	s32 level_size [MAX_MAX_OBJECTS + 1];
+	PoolTreeNode *level [MAX_MAX_OBJECTS + 1];
+	s64 memory_usage;
+} PoolTree;
+
+// Selects the pool for the next round while the candidates are made. The pool is the max_pool_size candidates with the lowest cost, and the candidates with the highest
+// cost that is used are chosen at random. This is done by giving each candidate a sort key with the cost in the high bits and random tie-break bits below, and keeping
+// the candidates with the lowest keys, which picks a uniform random subset of the boundary cost. A candidate with a key above cutoff_key is dropped at once. When the kept
+// candidates reach twice the pool size, cutoff_key is lowered to the key of the last candidate in the pool and the others are removed, so the memory use is proportional
+// to the pool size rather than to the number of candidates
+// Candidates that settle into the same pattern are equivalent for the rest of the search, so only one of them is kept, to get a more diverse pool. This is the one whose
+// reaction settled first, and of those the one that was found first. The duplicates are removed at each compaction, using settled_state to find them
+// compaction_cnt counts all compactions since the selector was created
+typedef struct
+{
+	s32 max_pool_size;
+	u64 cutoff_key;
+	s64 total_candidate_cnt;
+	s64 duplicate_candidate_cnt;
+	s64 compaction_cnt;
+	s32 candidate_cnt [COST_OFF];
+	ByteSeqStore kept;
+	ByteSeqStore compact_temp;
+	u64 *boundary_key;
+	HashTable_u64 settled_state;
+} PoolSelector;
+
+// The object sets that have already been tested. This is either an exact hash table that grows as needed, or an approximate filter with a fixed memory size
+// With the filter, an untested object set is occasionally treated as tested, and a tested one may be tested again once the filter is nearly full
+typedef struct
+{
+	int use_filter;
+	HashTable_u64 table;
+	CuckooFilter_u64 filter;
+} TestedSetups;
+
+// Costs of settled patterns that have been seen before, keyed by the hash of both phases of the pattern. The table is cleared when it has max_entry_cnt entries
+typedef struct
+{
+	u64 max_entry_cnt;
+	u64 lookup_cnt;
+	u64 hit_cnt;
+	HashTable_u64 table;
+} CostCache;
+
+typedef struct
+{
+	u32 dedup_filter_mb;
+	u64 expected_setup_cnt;
+	u32 spill_mb;
+	u32 cost_cache_mb;
+	int bench;
+	int use_seed;
+	u64 seed;
+	const char *trace_filename;
+	const char *status_filename;
+	u32 status_interval;
+	u32 mem_limit_mb;
+	u32 time_limit;
+	const char *best_filename;
+	const char *instrument_json_filename;
+} SearchOptions;
+
+// Counters for the summary of --bench mode, taken at the start of the search and of the current round. Each call to run_setup ends with exactly one of out_of_bounds,
+// settled and lasted_too_long being counted, so their sum is the number of calls
+// The hardware performance counters are only opened in --bench mode
+typedef struct
+{
+	double start_time;
+	double round_start_time;
+	u64 round_start_outcome_cnt [3];
+	u64 round_start_gens;
+	s64 total_candidate_cnt;
+	int round_cnt;
+	PerfCounters perf;
+	PerfCounterValues start_perf;
+	PerfCounterValues round_start_perf;
+} BenchStats;
+
+// A status line is printed to stderr every interval seconds during the search, and if filename is not NULL, the same values are written to that file as a JSON object
+// The file is written under a temporary name and then renamed, so that a reader never sees a partly written file
+typedef struct
+{
+	double interval;
+	const char *filename;
+	char temp_filename [MAX_FILENAME_SIZE + 16];
+	double start_time;
+	double round_start_time;
+	double next_report_time;
+	u64 round_start_gens;
+	u64 round_start_setup_cnt;
+} ProgressStatus;
+
+// The memory limit of --mem-limit in bytes, where 0 means no limit. Each time the tracked memory is above MEMORY_LIMIT_ADAPT_PART of the limit, the search takes one
+// step to use less: first the cost cache is halved until it is turned off, then the tested object sets are moved to an approximate filter, and after that the pool
+// size is halved, down to MIN_ADAPTED_POOL_SIZE. If nothing more can be done, a warning is printed and the limit is no longer checked
+// A smaller pool size only frees memory at the next compaction of the pool candidates, so after each step, the next one waits until the candidates have been compacted
+// or the next round has started
+// max_pool_size is the largest pool size the memory allows, which the time limit never goes above
+typedef struct
+{
+	u64 limit;
+	int exhausted;
+	int waiting;
+	s64 step_compaction_cnt;
+	s32 max_pool_size;
+} MemoryLimit;
+
+// The end of the search set by --time-limit, and the time per parent pattern measured in the last round, including the work after the last parent. Before each
+// round, the size of the pool it selects is set so that the rounds left are expected to end in time. If the time still runs out, the round ends early and the
+// candidates found so far become the last pool
+typedef struct
+{
+	int on;
+	int expired;
+	double end_time;
+	double seconds_per_parent;
+} TimeLimit;
+
 
 static GoLGrid _gg [GG_ARRAY_CNT];
 static GoLGrid *gg [GG_ARRAY_CNT];
 
 static s32 poss_object_cnt = 0;
 static AddedObject poss_object [MAX_POSS_OBJECTS];
+static u64 poss_object_key [MAX_POSS_OBJECTS];
+
+static int symmetry_cnt = 1;
+static int symmetry_transform [8] = {0};
+static Rect symmetry_frame;
 
 static CensusObject census_obj [MAX_CENSUS_OBJECTS];
 static TreeEdge tree_edge [(MAX_CENSUS_OBJECTS - 1) * MAX_CENSUS_OBJECTS / 2];
 
+// The trace of the search written with --trace. It has spans for each round, each parent pattern, each compaction of the pool candidates, and one of every
+// TRACE_SETUP_SAMPLE_INTERVAL calls to run_setup
+static Trace trace;
+
 static const CellList_s8 *get_object_cell_list (int object_type)
 {
 	if (object_type == 0)
@@ -93,41 +326,582 @@ static const CellList_s8 *get_object_cell_list (int object_type)
 	return NULL;
 }
 
-static void store_object_list (const AddedObject *obj_list, int obj_cnt, s32 cost, ByteSeqStore *bss)
+// A set of objects is identified by the xor of the keys of its members. New objects are never allowed to overlap or touch the ones already placed (see locked_out_area
+// in add_next_object), so a set of objects is already in canonical form and two different sets can't produce the same grid. The key is a bijective mix of
+// (object_type, left_x, top_y), so it can be recomputed for any object without a lookup
+static __force_inline u64 get_object_key (int object_type, int left_x, int top_y)
 {
-	int byte_seq_ix = 0;
-	u8 byte_seq [MAX_BYTE_SEQ_SIZE];
+	u64 key = (((u64) (u8) object_type) << 16) | (((u64) (u8) left_x) << 8) | ((u64) (u8) top_y);
 	
-	byte_seq [byte_seq_ix++] = (u8) (obj_cnt);
+	key = (key ^ 0x0123456789abcdefu) * 0xc6a4a7935bd1e995u;
+	key = key ^ (key >> 47);
+	key = key * 0xc6a4a7935bd1e995u;
+	return key ^ (key >> 47);
+}
+
+static u64 get_object_list_key (const AddedObject *obj_list, int obj_cnt)
+{
+	u64 key = 0;
 	
 	int obj_ix;
 	for (obj_ix = 0; obj_ix < obj_cnt; obj_ix++)
+		key ^= get_object_key (obj_list [obj_ix].object_type, obj_list [obj_ix].left_x, obj_list [obj_ix].top_y);
+	
+	return key;
+}
+
+// A pool record is the index of the parent pattern in the previous level of the PoolTree, the added object, the sort key, which has the cost in its highest 16 bits,
+// the key of the settled pattern and the generation when it settled
+static void store_pool_record (s32 parent_ix, const AddedObject *new_obj, u64 sort_key, u64 settled_key, s32 stable_gen, ByteSeqStore *bss)
+{
+	u8 byte_seq [POOL_RECORD_SIZE];
+	
+	byte_seq [0] = (u8) (((u32) parent_ix) >> 24);
+	byte_seq [1] = (u8) ((((u32) parent_ix) >> 16) & 0xff);
+	byte_seq [2] = (u8) ((((u32) parent_ix) >> 8) & 0xff);
+	byte_seq [3] = (u8) (((u32) parent_ix) & 0xff);
+	byte_seq [4] = (u8) (new_obj->object_type);
+	byte_seq [5] = (u8) (new_obj->left_x);
+	byte_seq [6] = (u8) (new_obj->top_y);
+	
+	int byte_ix;
+	for (byte_ix = 0; byte_ix < 8; byte_ix++)
+		byte_seq [7 + byte_ix] = (u8) ((sort_key >> (56 - 8 * byte_ix)) & 0xff);
+	
+	for (byte_ix = 0; byte_ix < 8; byte_ix++)
+		byte_seq [15 + byte_ix] = (u8) ((settled_key >> (56 - 8 * byte_ix)) & 0xff);
+	
+	byte_seq [23] = (u8) (((u32) stable_gen) >> 8);
+	byte_seq [24] = (u8) (((u32) stable_gen) & 0xff);
+	
+	ByteSeqStore_store (bss, byte_seq, POOL_RECORD_SIZE);
+}
+
+static u64 get_sort_key (const u8 *byte_seq)
+{
+	u64 sort_key = 0;
+	
+	int byte_ix;
+	for (byte_ix = 0; byte_ix < 8; byte_ix++)
+		sort_key = (sort_key << 8) | (u64) byte_seq [7 + byte_ix];
+	
+	return sort_key;
+}
+
+static u64 get_settled_key_of_record (const u8 *byte_seq)
+{
+	u64 settled_key = 0;
+	
+	int byte_ix;
+	for (byte_ix = 0; byte_ix < 8; byte_ix++)
+		settled_key = (settled_key << 8) | (u64) byte_seq [15 + byte_ix];
+	
+	return settled_key;
+}
+
+static s32 get_stable_gen (const u8 *byte_seq)
+{
+	return (s32) ((((u32) (byte_seq [23])) << 8) + (u32) (byte_seq [24]));
+}
+
+static s32 get_cost (const u8 *byte_seq)
+{
+	return (s32) ((((u32) (byte_seq [7])) << 8) + (u32) (byte_seq [8]));
+}
+
+static void get_pool_record (const u8 *byte_seq, PoolTreeNode *node)
+{
+	node->parent_ix = (s32) ((((u32) byte_seq [0]) << 24) | (((u32) byte_seq [1]) << 16) | (((u32) byte_seq [2]) << 8) | (u32) byte_seq [3]);
+	node->object_type = byte_seq [4];
+	node->left_x = (s8) byte_seq [5];
+	node->top_y = (s8) byte_seq [6];
+	node->cost = (u16) get_cost (byte_seq);
+}
+
+static void preinit_pool_tree (PoolTree *tree)
+{
+	tree->level_cnt = 0;
+	tree->memory_usage = 0;
+	
+	int level_ix;
+	for (level_ix = 0; level_ix <= MAX_MAX_OBJECTS; level_ix++)
 	{
-		byte_seq [byte_seq_ix++] = (u8) (obj_list [obj_ix].object_type);
-		byte_seq [byte_seq_ix++] = (u8) (obj_list [obj_ix].left_x);
-		byte_seq [byte_seq_ix++] = (u8) (obj_list [obj_ix].top_y);
+		tree->level_size [level_ix] = 0;
+		tree->level [level_ix] = NULL;
 	}
+}
+
+static void free_pool_tree (PoolTree *tree)
+{
+	int level_ix;
+	for (level_ix = 0; level_ix < tree->level_cnt; level_ix++)
+		if (tree->level [level_ix])
+			free (tree->level [level_ix]);
 	
-	byte_seq [byte_seq_ix++] = (u8) (((u32) cost) >> 8);
-	byte_seq [byte_seq_ix++] = (u8) (((u32) cost) & 0xff);
-	
-	ByteSeqStore_store (bss, byte_seq, byte_seq_ix);
+	preinit_pool_tree (tree);
 }
 
-static int get_object_list (const u8 *byte_seq, AddedObject *obj_list)
+// Adds a level with room for node_cnt nodes to the tree. The caller fills in the nodes and can lower level_size if fewer were needed
+static PoolTreeNode *add_pool_tree_level (PoolTree *tree, s32 node_cnt)
 {
-	s32 byte_seq_ix = 0;
-	int obj_cnt = byte_seq [byte_seq_ix++];
+	if (tree->level_cnt > MAX_MAX_OBJECTS)
+		return ffsc_p (__func__);
+	
+	PoolTreeNode *level = malloc ((size_t) higher_of_s32 (node_cnt, 1) * sizeof (PoolTreeNode));
+	if (!level)
+	{
+		fprintf (stderr, "Out of memory in %s\n", __func__);
+		return NULL;
+	}
+	
+	tree->level [tree->level_cnt] = level;
+	tree->level_size [tree->level_cnt] = node_cnt;
+	tree->level_cnt++;
+	tree->memory_usage += (s64) node_cnt * (s64) sizeof (PoolTreeNode);
 	
+	return level;
+}
+
+static int get_object_list (const PoolTree *tree, int level_ix, s32 node_ix, AddedObject *obj_list)
+{
 	int obj_ix;
-	for (obj_ix = 0; obj_ix < obj_cnt; obj_ix++)
+	for (obj_ix = level_ix - 1; obj_ix >= 0; obj_ix--)
+	{
+		const PoolTreeNode *node = &tree->level [obj_ix + 1] [node_ix];
+		
+		obj_list [obj_ix].object_type = (int) node->object_type;
+		obj_list [obj_ix].left_x = (int) node->left_x;
+		obj_list [obj_ix].top_y = (int) node->top_y;
+		
+		node_ix = node->parent_ix;
+	}
+	
+	return level_ix;
+}
+
+static void clear_pool_selector (PoolSelector *sel)
+{
+	sel->cutoff_key = u64_MAX;
+	sel->total_candidate_cnt = 0;
+	sel->duplicate_candidate_cnt = 0;
+	
+	s32 cost_ix;
+	for (cost_ix = 0; cost_ix < COST_OFF; cost_ix++)
+		sel->candidate_cnt [cost_ix] = 0;
+	
+	ByteSeqStore_clear (&sel->kept);
+	ByteSeqStore_clear (&sel->compact_temp);
+}
+
+// If spill_memory_size is not 0, each of the two candidate stores spills to a temporary file when it uses more memory than that
+static int create_pool_selector (PoolSelector *sel, s32 max_pool_size, s64 spill_memory_size)
+{
+	sel->max_pool_size = max_pool_size;
+	sel->compaction_cnt = 0;
+	sel->boundary_key = malloc ((size_t) (2 * max_pool_size + 1) * sizeof (u64));
+	
+	if (!sel->boundary_key || !ByteSeqStore_create (&sel->kept, 16384) || !ByteSeqStore_create (&sel->compact_temp, 16384) ||
+			!HashTable_u64_create (&sel->settled_state, 64, 0.7, 0.9, HASHTABLE_U64_EPOCH_CLEAR) || !HashTable_u64_reserve (&sel->settled_state, 2 * (u64) max_pool_size))
+	{
+		fprintf (stderr, "Out of memory in %s\n", __func__);
+		return FALSE;
+	}
+	
+	if (spill_memory_size != 0)
+		if (!ByteSeqStore_set_spill (&sel->kept, spill_memory_size) || !ByteSeqStore_set_spill (&sel->compact_temp, spill_memory_size))
+			return FALSE;
+	
+	clear_pool_selector (sel);
+	return TRUE;
+}
+
+static int compare_u64 (const void *key_1, const void *key_2)
+{
+	if (*(const u64 *) key_1 < *(const u64 *) key_2)
+		return -1;
+	else if (*(const u64 *) key_1 > *(const u64 *) key_2)
+		return 1;
+	else
+		return 0;
+}
+
+// Lowers cutoff_key so that only max_pool_size of the kept candidates are below or at it, and removes the other ones
+// The first pass finds the best candidate for each settled pattern, ranked by stable generation and then by position in kept, and the second pass copies only those
+static int remove_duplicate_candidates (PoolSelector *sel)
+{
+	HashTable_u64_clear (&sel->settled_state);
+	
+	// Two passes over the records, with a hash table access for each record in both
+	INSTRUMENT_ADD_BYTES (PHASE_POOL_COMPACTION, 2 * (POOL_RECORD_SIZE + CACHE_LINE_BYTES) * (u64) sel->kept.seq_count);
+	
+	ByteSeqStoreNode *bss_node;
+	s32 node_data_offset;
+	const u8 *byte_seq;
+	s64 seq_ix = 0;
+	
+	ByteSeqStore_start_get_iteration (&sel->kept, &bss_node, &node_data_offset);
+	while (ByteSeqStore_get_next_view (&sel->kept, &bss_node, &node_data_offset, &byte_seq, NULL))
+	{
+		u64 settled_key = get_settled_key_of_record (byte_seq);
+		u64 rank = (((u64) get_stable_gen (byte_seq)) << 40) | (u64) seq_ix;
+		
+		u64 best_rank;
+		if (!HashTable_u64_get_data (&sel->settled_state, settled_key, &best_rank) || rank < best_rank)
+			if (!HashTable_u64_store (&sel->settled_state, settled_key, rank, TRUE, NULL))
+				return FALSE;
+		
+		seq_ix++;
+	}
+	
+	if ((s64) sel->settled_state.used_capacity == sel->kept.seq_count)
+		return TRUE;
+	
+	ByteSeqStore_clear (&sel->compact_temp);
+	
+	seq_ix = 0;
+	ByteSeqStore_start_get_iteration (&sel->kept, &bss_node, &node_data_offset);
+	while (ByteSeqStore_get_next_view (&sel->kept, &bss_node, &node_data_offset, &byte_seq, NULL))
+	{
+		u64 best_rank;
+		HashTable_u64_get_data (&sel->settled_state, get_settled_key_of_record (byte_seq), &best_rank);
+		
+		if ((best_rank & ((((u64) 1) << 40) - 1)) == (u64) seq_ix)
+		{
+			if (!ByteSeqStore_store (&sel->compact_temp, byte_seq, POOL_RECORD_SIZE))
+				return FALSE;
+		}
+		else
+		{
+			sel->candidate_cnt [get_cost (byte_seq)]--;
+			sel->duplicate_candidate_cnt++;
+		}
+		
+		seq_ix++;
+	}
+	
+	ByteSeqStore_swap (&sel->kept, &sel->compact_temp);
+	ByteSeqStore_clear (&sel->compact_temp);
+	return TRUE;
+}
+
+static int compact_pool_candidates (PoolSelector *sel)
+{
+	sel->compaction_cnt++;
+	
+	if (!remove_duplicate_candidates (sel))
+		return FALSE;
+	
+	if (sel->kept.seq_count <= (s64) sel->max_pool_size)
+		return TRUE;
+	
+	// Three passes over the records
+	INSTRUMENT_ADD_BYTES (PHASE_POOL_COMPACTION, 3 * POOL_RECORD_SIZE * (u64) sel->kept.seq_count);
+	
+	s32 kept_cnt [COST_OFF];
+	s32 cost_ix;
+	for (cost_ix = 0; cost_ix < COST_OFF; cost_ix++)
+		kept_cnt [cost_ix] = 0;
+	
+	// The records are read in place, as these passes run over every kept candidate
+	ByteSeqStoreNode *bss_node;
+	s32 node_data_offset;
+	const u8 *byte_seq;
+	
+	ByteSeqStore_start_get_iteration (&sel->kept, &bss_node, &node_data_offset);
+	while (ByteSeqStore_get_next_view (&sel->kept, &bss_node, &node_data_offset, &byte_seq, NULL))
+		kept_cnt [get_cost (byte_seq)]++;
+	
+	s32 below_cnt = 0;
+	for (cost_ix = 0; cost_ix < COST_OFF; cost_ix++)
+	{
+		if (below_cnt + kept_cnt [cost_ix] >= sel->max_pool_size)
+			break;
+		
+		below_cnt += kept_cnt [cost_ix];
+	}
+	
+	// Only the keys of the boundary cost need to be sorted to find the new cutoff
+	s32 boundary_cnt = 0;
+	ByteSeqStore_start_get_iteration (&sel->kept, &bss_node, &node_data_offset);
+	while (ByteSeqStore_get_next_view (&sel->kept, &bss_node, &node_data_offset, &byte_seq, NULL))
+		if (get_cost (byte_seq) == cost_ix)
+			sel->boundary_key [boundary_cnt++] = get_sort_key (byte_seq);
+	
+	qsort (sel->boundary_key, boundary_cnt, sizeof (sel->boundary_key [0]), &compare_u64);
+	sel->cutoff_key = sel->boundary_key [sel->max_pool_size - below_cnt - 1];
+	
+	ByteSeqStore_clear (&sel->compact_temp);
+	
+	s32 kept_in_pool_cnt = 0;
+	ByteSeqStore_start_get_iteration (&sel->kept, &bss_node, &node_data_offset);
+	while (ByteSeqStore_get_next_view (&sel->kept, &bss_node, &node_data_offset, &byte_seq, NULL))
+		if (get_sort_key (byte_seq) <= sel->cutoff_key && kept_in_pool_cnt < sel->max_pool_size)
+		{
+			if (!ByteSeqStore_store (&sel->compact_temp, byte_seq, POOL_RECORD_SIZE))
+				return FALSE;
+			
+			kept_in_pool_cnt++;
+		}
+	
+	ByteSeqStore_swap (&sel->kept, &sel->compact_temp);
+	ByteSeqStore_clear (&sel->compact_temp);
+	return TRUE;
+}
+
+static __force_inline int add_pool_candidate (PoolSelector *sel, s32 parent_ix, const AddedObject *new_obj, s32 cost, u64 settled_key, s32 stable_gen)
+{
+	sel->candidate_cnt [cost]++;
+	sel->total_candidate_cnt++;
+	
+	u64 sort_key = (((u64) cost) << 48) | (random_u64 () >> 16);
+	if (sort_key > sel->cutoff_key)
+		return TRUE;
+	
+	store_pool_record (parent_ix, new_obj, sort_key, settled_key, stable_gen, &sel->kept);
+	
+	if (sel->kept.seq_count >= 2 * (s64) sel->max_pool_size)
+	{
+		double trace_start = Trace_start_span (&trace);
+		INSTRUMENT_ENTER (PHASE_POOL_COMPACTION);
+		int compacted = compact_pool_candidates (sel);
+		INSTRUMENT_LEAVE ();
+		Trace_add_span (&trace, "compact_pool_candidates", "pool", trace_start, sel->kept.seq_count);
+		
+		return compacted;
+	}
+	
+	return TRUE;
+}
+
+static int create_tested_setups (TestedSetups *ts, u64 filter_memory_size, u64 expected_setup_cnt)
+{
+	HashTable_u64_preinit (&ts->table);
+	CuckooFilter_u64_preinit (&ts->filter);
+	ts->use_filter = (filter_memory_size != 0);
+	
+	if (ts->use_filter)
+		return CuckooFilter_u64_create (&ts->filter, filter_memory_size);
+	
+	// The table can grow very large, so it moves its entries gradually when it grows, to avoid long pauses
+	if (!HashTable_u64_create (&ts->table, 64, 0.7, 0.9, HASHTABLE_U64_KEYS_ONLY | HASHTABLE_U64_INCREMENTAL_RESIZE))
+		return FALSE;
+	
+	if (expected_setup_cnt != 0 && !HashTable_u64_reserve (&ts->table, expected_setup_cnt))
+		fprintf (stderr, "Not enough memory for %" PRIu64 " tested setups, starting with a smaller table\n", expected_setup_cnt);
+	
+	return TRUE;
+}
+
+static int store_tested_setups_batch (TestedSetups *ts, const u64 *key, int key_cnt, int *was_present)
+{
+	if (ts->use_filter)
+		return CuckooFilter_u64_store_batch (&ts->filter, key, key_cnt, was_present);
+	else
+		return HashTable_u64_store_batch (&ts->table, key, key_cnt, was_present);
+}
+
+static void print_tested_setups_statistics (const TestedSetups *ts)
+{
+	if (ts->use_filter)
+		fprintf (stderr, "Tested setups: %" PRIu64 " in filter (%.1f MB), estimated false positive rate = %.4f%%, dropped = %" PRIu64 "\n", ts->filter.used_capacity,
+				(double) CuckooFilter_u64_memory_size (&ts->filter) / 1048576.0, 100.0 * CuckooFilter_u64_false_positive_rate (&ts->filter), ts->filter.dropped_cnt);
+	else
+		fprintf (stderr, "Tested setups: %" PRIu64 " in hash table (%.1f MB)\n", ts->table.used_capacity, (double) HashTable_u64_memory_size (&ts->table) / 1048576.0);
+}
+
+// The table gets its full size at once, with the largest power of two slots that fits in max_memory_size, where each slot takes a control byte, an epoch byte, the
+// key and the data. It is cleared before it would grow, so the cache never uses more than max_memory_size. If there is room for fewer than MIN_COST_CACHE_ENTRIES
+// entries, the cache is disabled
+static int create_cost_cache (CostCache *cc, u64 max_memory_size)
+{
+	HashTable_u64_preinit (&cc->table);
+	cc->max_entry_cnt = 0;
+	cc->lookup_cnt = 0;
+	cc->hit_cnt = 0;
+	
+	u64 slot_size = 2 * sizeof (u8) + 2 * sizeof (u64);
+	u64 capacity = 1;
+	while (2 * capacity * slot_size <= max_memory_size)
+		capacity *= 2;
+	
+	if (COST_CACHE_FILLED_PART * (double) capacity < (double) MIN_COST_CACHE_ENTRIES)
+		return TRUE;
+	
+	if (!HashTable_u64_create (&cc->table, capacity, COST_CACHE_FILLED_PART, 0.9, HASHTABLE_U64_EPOCH_CLEAR))
+		return FALSE;
+	
+	// HashTable_u64_store grows the table when it has reallocate_capacity entries
+	cc->max_entry_cnt = cc->table.reallocate_capacity;
+	return TRUE;
+}
+
+// Both phases of a settled pattern give the same key, and phase_hash_1 is always the lower hash of the two
+static __force_inline u64 get_settled_key (u64 phase_hash_0, u64 phase_hash_1)
+{
+	u64 key = phase_hash_0 ^ ((phase_hash_1 << 29) | (phase_hash_1 >> 35));
+	return (key != 0 ? key : 1);
+}
+
+static __force_inline int get_cached_cost (CostCache *cc, u64 key, s32 *cost)
+{
+	if (cc->max_entry_cnt == 0)
+		return FALSE;
+	
+	cc->lookup_cnt++;
+	
+	u64 data;
+	if (!HashTable_u64_get_data (&cc->table, key, &data))
+		return FALSE;
+	
+	cc->hit_cnt++;
+	*cost = (s32) data;
+	return TRUE;
+}
+
+static __force_inline void store_cached_cost (CostCache *cc, u64 key, s32 cost)
+{
+	if (cc->max_entry_cnt == 0)
+		return;
+	
+	if (cc->table.used_capacity >= cc->max_entry_cnt)
+		HashTable_u64_clear (&cc->table);
+	
+	HashTable_u64_store (&cc->table, key, (u64) cost, TRUE, NULL);
+}
+
+static void print_cost_cache_statistics (CostCache *cc)
+{
+	if (cc->max_entry_cnt == 0)
+		return;
+	
+	fprintf (stderr, "Cost cache: %" PRIu64 " lookups, hit rate = %.2f%%, %" PRIu64 " entries (%.1f MB)\n", cc->lookup_cnt,
+			(cc->lookup_cnt != 0 ? 100.0 * (double) cc->hit_cnt / (double) cc->lookup_cnt : 0.0), cc->table.used_capacity, (double) HashTable_u64_memory_size (&cc->table) / 1048576.0);
+	
+	cc->lookup_cnt = 0;
+	cc->hit_cnt = 0;
+}
+
+// Empties the cache and limits it to max_memory_size bytes, where 0 turns it off
+static int resize_cost_cache (CostCache *cc, u64 max_memory_size)
+{
+	u64 lookup_cnt = cc->lookup_cnt;
+	u64 hit_cnt = cc->hit_cnt;
+	
+	HashTable_u64_free (&cc->table);
+	if (!create_cost_cache (cc, max_memory_size))
+		return FALSE;
+	
+	cc->lookup_cnt = lookup_cnt;
+	cc->hit_cnt = hit_cnt;
+	return TRUE;
+}
+
+static u64 get_tested_setups_memory_size (const TestedSetups *ts)
+{
+	return (ts->use_filter ? CuckooFilter_u64_memory_size (&ts->filter) : HashTable_u64_memory_size (&ts->table));
+}
+
+// Moves the object sets in the hash table to an approximate filter that uses filter_memory_size bytes, and frees the hash table
+static int switch_tested_setups_to_filter (TestedSetups *ts, u64 filter_memory_size)
+{
+	if (ts->use_filter)
+		return TRUE;
+	
+	if (!CuckooFilter_u64_create (&ts->filter, filter_memory_size))
+		return FALSE;
+	
+	u64 entry_ix = 0;
+	u64 key;
+	while (HashTable_u64_get_next_key (&ts->table, &entry_ix, &key))
+		CuckooFilter_u64_store (&ts->filter, key, NULL);
+	
+	HashTable_u64_free (&ts->table);
+	ts->use_filter = TRUE;
+	return TRUE;
+}
+
+// The memory of the data structures that grow during the search. The grids and other fixed size arrays are not included
+static u64 get_search_memory_usage (const PoolTree *tree, const PoolSelector *sel, const TestedSetups *ts, const CostCache *cc, const HashTable_u64 *seen_starting_points)
+{
+	return (u64) tree->memory_usage + (u64) sel->kept.memory_usage + (u64) sel->compact_temp.memory_usage + HashTable_u64_memory_size (&sel->settled_state) +
+			get_tested_setups_memory_size (ts) + HashTable_u64_memory_size (&cc->table) + HashTable_u64_memory_size (seen_starting_points);
+}
+
+// Takes the next step to use less memory, if the tracked memory is close to the limit. Returns FALSE only if out of memory
+static int enforce_memory_limit (MemoryLimit *ml, const PoolTree *tree, PoolSelector *sel, TestedSetups *ts, CostCache *cc, const HashTable_u64 *seen_starting_points)
+{
+	if (ml->limit == 0 || ml->exhausted || (ml->waiting && sel->compaction_cnt == ml->step_compaction_cnt))
+		return TRUE;
+	
+	u64 usage = get_search_memory_usage (tree, sel, ts, cc, seen_starting_points);
+	if ((double) usage <= MEMORY_LIMIT_ADAPT_PART * (double) ml->limit)
+		return TRUE;
+	
+	ByteSeqStore_release_free_nodes (&sel->kept);
+	ByteSeqStore_release_free_nodes (&sel->compact_temp);
+	
+	usage = get_search_memory_usage (tree, sel, ts, cc, seen_starting_points);
+	if ((double) usage <= MEMORY_LIMIT_ADAPT_PART * (double) ml->limit)
+		return TRUE;
+	
+	ml->waiting = TRUE;
+	ml->step_compaction_cnt = sel->compaction_cnt;
+	
+	if (cc->max_entry_cnt != 0)
+	{
+		if (!resize_cost_cache (cc, HashTable_u64_memory_size (&cc->table) / 2))
+			return FALSE;
+		
+		fprintf (stderr, "Memory limit: %.1f MB in use, %s the cost cache\n", (double) usage / 1048576.0, (cc->max_entry_cnt == 0 ? "turned off" : "shrunk"));
+		return TRUE;
+	}
+	
+	if (!ts->use_filter)
+	{
+		u64 filter_memory_size = lower_of_u64 (ml->limit / 4, get_tested_setups_memory_size (ts) / 2);
+		
+		fprintf (stderr, "Memory limit: %.1f MB in use, moving the tested object sets to an approximate filter of at most %.1f MB\n", (double) usage / 1048576.0,
+				(double) filter_memory_size / 1048576.0);
+		return switch_tested_setups_to_filter (ts, filter_memory_size);
+	}
+	
+	if (sel->max_pool_size > MIN_ADAPTED_POOL_SIZE)
 	{
-		obj_list [obj_ix].object_type = (int) byte_seq [byte_seq_ix++];
-		obj_list [obj_ix].left_x = (int) (s8) byte_seq [byte_seq_ix++];
-		obj_list [obj_ix].top_y = (int) (s8) byte_seq [byte_seq_ix++];
+		sel->max_pool_size = higher_of_s32 (MIN_ADAPTED_POOL_SIZE, sel->max_pool_size / 2);
+		ml->max_pool_size = sel->max_pool_size;
+		
+		fprintf (stderr, "Memory limit: %.1f MB in use, reducing the pool size to %d\n", (double) usage / 1048576.0, (int) sel->max_pool_size);
+		return TRUE;
 	}
 	
-	return obj_cnt;
+	fprintf (stderr, "Warning: The memory limit of %.1f MB can't be kept, %.1f MB is in use\n", (double) ml->limit / 1048576.0, (double) usage / 1048576.0);
+	ml->exhausted = TRUE;
+	return TRUE;
+}
+
+// Sets the size of the pool selected in this round, so that this round and the ones left are expected to take the remaining time. The pool size is never set
+// above the one given by the user or allowed by the memory limit, or below MIN_ADAPTED_POOL_SIZE
+static void adapt_pool_size_to_time_limit (const TimeLimit *tl, const MemoryLimit *ml, PoolSelector *sel, s32 max_pool_size, int obj_cnt, int max_obj_cnt,
+		s32 parent_cnt)
+{
+	if (!tl->on || tl->seconds_per_parent <= 0.0 || obj_cnt >= max_obj_cnt)
+		return;
+	
+	double seconds_left = tl->end_time - get_wall_seconds () - tl->seconds_per_parent * (double) parent_cnt;
+	double planned_size = seconds_left / (TIME_LIMIT_MARGIN * tl->seconds_per_parent * (double) (max_obj_cnt - obj_cnt));
+	
+	s32 highest_size = lower_of_s32 (max_pool_size, ml->max_pool_size);
+	s32 new_size = lower_of_s32 (MIN_ADAPTED_POOL_SIZE, highest_size);
+	if (planned_size > (double) highest_size)
+		new_size = highest_size;
+	else if (planned_size > (double) new_size)
+		new_size = (s32) planned_size;
+	
+	if (new_size != sel->max_pool_size)
+	{
+		fprintf (stderr, "Time limit: %.0f s left, setting the pool size to %d\n", tl->end_time - get_wall_seconds (), (int) new_size);
+		sel->max_pool_size = new_size;
+	}
 }
 
 static s32 census_pattern (const GoLGrid *pattern, CensusObject *obj, int max_obj)
@@ -184,15 +958,6 @@ static s32 census_pattern (const GoLGrid *pattern, CensusObject *obj, int max_ob
 	return obj_ix;
 }
 
-static s32 get_cost (const u8 *byte_seq)
-{
-	s32 byte_seq_ix = 0;
-	int obj_cnt = byte_seq [byte_seq_ix++];
-	byte_seq_ix += (3 * obj_cnt);
-	
-	return (s32) ((((u32) (byte_seq [byte_seq_ix])) << 8) + (u32) (byte_seq [byte_seq_ix + 1]));
-}
-
 static double calc_edge_length_sq (const CensusObject *obj_1, const CensusObject *obj_2)
 {
 	double x_dist_sq = (obj_2->mid_x - obj_1->mid_x) * (obj_2->mid_x - obj_1->mid_x);
@@ -265,46 +1030,119 @@ static void object_list_to_grid (const AddedObject *obj_list, int obj_cnt, GoLGr
 		GoLGrid_or_cell_list (out_gg, get_object_cell_list (obj_list [obj_ix].object_type), obj_list [obj_ix].left_x, obj_list [obj_ix].top_y);
 }
 
-static void byte_seq_to_grid (const u8 *byte_seq, GoLGrid *out_gg)
+// The bytes of the grid words within the population rectangle, which is what most GoLGrid functions read or write of a grid
+static __force_inline u64 get_pop_rect_bytes (const GoLGrid *gg)
 {
-	GoLGrid_clear_noinline (out_gg);
+	if (gg->pop_x_off <= gg->pop_x_on)
+		return 0;
 	
-	int obj_ix;
-	for (obj_ix = 0; obj_ix < (s32) byte_seq [0]; obj_ix++)
-		GoLGrid_or_cell_list (out_gg, get_object_cell_list ((int) byte_seq [1 + 3 * obj_ix]), (int) (s8) byte_seq [2 + 3 * obj_ix], (int) (s8) byte_seq [3 + 3 * obj_ix]);
+	return sizeof (u64) * (u64) (((gg->pop_x_off + 63) >> 6) - (gg->pop_x_on >> 6)) * (u64) (gg->pop_y_off - gg->pop_y_on);
 }
 
 static u64 out_of_bounds = 0;
 static u64 settled = 0;
 static u64 lasted_too_long = 0;
+static u64 simulated_gens = 0;
+
+// The calls to run_setup in the current round, by outcome and by the number of generations simulated before the outcome. Bucket 0 is for 0 generations, and bucket n
+// for 2^(n - 1) to 2^n - 1 generations. The generations of all outcomes in each bucket are summed in gen_sum, to show where the simulation time goes
+static u64 outcome_gen_histogram [OUTCOME_CNT][GEN_BUCKET_CNT];
+static u64 outcome_gen_sum [GEN_BUCKET_CNT];
+
+static const char *const outcome_name [OUTCOME_CNT] = {"settled", "out of bounds", "lasted too long"};
+
+static __force_inline void record_outcome_gens (int outcome_ix, s32 gen)
+{
+	int bucket_ix = (gen == 0 ? 0 : lower_of_s32 (1 + most_significant_bit_u64 ((u64) gen), GEN_BUCKET_CNT - 1));
+	outcome_gen_histogram [outcome_ix][bucket_ix]++;
+	outcome_gen_sum [bucket_ix] += (u64) gen;
+}
+
+static void clear_outcome_gen_histogram (void)
+{
+	int outcome_ix;
+	int bucket_ix;
+	for (bucket_ix = 0; bucket_ix < GEN_BUCKET_CNT; bucket_ix++)
+	{
+		for (outcome_ix = 0; outcome_ix < OUTCOME_CNT; outcome_ix++)
+			outcome_gen_histogram [outcome_ix][bucket_ix] = 0;
+		
+		outcome_gen_sum [bucket_ix] = 0;
+	}
+}
+
+static void print_outcome_gen_histogram (void)
+{
+	u64 total_gens = 0;
+	int bucket_ix;
+	for (bucket_ix = 0; bucket_ix < GEN_BUCKET_CNT; bucket_ix++)
+		total_gens += outcome_gen_sum [bucket_ix];
+	
+	fprintf (stderr, "Generations before outcome: %15s %15s %15s %15s\n", outcome_name [0], outcome_name [1], outcome_name [2], "% of gens");
+	
+	for (bucket_ix = 0; bucket_ix < GEN_BUCKET_CNT; bucket_ix++)
+	{
+		u64 bucket_setup_cnt = outcome_gen_histogram [0][bucket_ix] + outcome_gen_histogram [1][bucket_ix] + outcome_gen_histogram [2][bucket_ix];
+		if (bucket_setup_cnt == 0)
+			continue;
+		
+		char range [32];
+		if (bucket_ix == 0)
+			sprintf (range, "0");
+		else
+			sprintf (range, "%d - %d", 1 << (bucket_ix - 1), (1 << bucket_ix) - 1);
+		
+		fprintf (stderr, "%26s: %15" PRIu64 " %15" PRIu64 " %15" PRIu64 " %14.2f%%\n", range, outcome_gen_histogram [0][bucket_ix], outcome_gen_histogram [1][bucket_ix],
+				outcome_gen_histogram [2][bucket_ix], (total_gens != 0 ? 100.0 * (double) outcome_gen_sum [bucket_ix] / (double) total_gens : 0.0));
+	}
+}
 
 // This function must not be inlined, or GCC will fail to vectorize the inlined calls to GoLGrid functions
-static __not_inline int run_setup (const GoLGrid *setup, const GoLGrid *allowed_area, const AddedObject *obj_list, int obj_cnt, ByteSeqStore *bss)
+static __not_inline int run_setup (const GoLGrid *setup, const GoLGrid *allowed_area, s32 parent_ix, const AddedObject *new_obj, const RandomDataArray *rda, CostCache *cost_cache,
+		PoolSelector *pool_selector)
 {
 	GoLGrid *ev_m2 = gg [5];
 	GoLGrid *ev_m1 = gg [6];
 	GoLGrid *ev_p0 = gg [7];
 	
+	INSTRUMENT_ENTER (PHASE_SETUP_EVOLUTION);
 	GoLGrid_copy_noinline (setup, ev_p0);
 	
 	s32 gen = 0;
 	while (TRUE)
 	{
+		// Each generation is checked against allowed_area and the generation before the last one, and evolved into a new grid
+		INSTRUMENT_ADD_BYTES (PHASE_SETUP_EVOLUTION, 6 * get_pop_rect_bytes (ev_p0));
+		
 		if (!GoLGrid_is_subset (ev_p0, allowed_area))
 		{
 			out_of_bounds++;
+			simulated_gens += (u64) gen;
+			record_outcome_gens (OUTCOME_OUT_OF_BOUNDS, gen);
+			INSTRUMENT_COUNT (COUNTER_OUT_OF_BOUNDS_SETUPS, 1);
+			INSTRUMENT_COUNT (COUNTER_OUT_OF_BOUNDS_GENS, (u64) gen);
+			INSTRUMENT_LEAVE ();
 			return FALSE;
 		}
 		
 		if (gen >= 2 && GoLGrid_is_equal (ev_p0, ev_m2))
 		{
 			settled++;
+			simulated_gens += (u64) gen;
+			record_outcome_gens (OUTCOME_SETTLED, gen);
+			INSTRUMENT_COUNT (COUNTER_SETTLED_SETUPS, 1);
+			INSTRUMENT_COUNT (COUNTER_SETTLED_GENS, (u64) gen);
 			break;
 		}
 		
 		if (gen >= MAX_NEW_GENS)
 		{
 			lasted_too_long++;
+			simulated_gens += (u64) gen;
+			record_outcome_gens (OUTCOME_LASTED_TOO_LONG, gen);
+			INSTRUMENT_COUNT (COUNTER_LASTED_TOO_LONG_SETUPS, 1);
+			INSTRUMENT_COUNT (COUNTER_LASTED_TOO_LONG_GENS, (u64) gen);
+			INSTRUMENT_LEAVE ();
 			return FALSE;
 		}
 		
@@ -318,10 +1156,45 @@ static __not_inline int run_setup (const GoLGrid *setup, const GoLGrid *allowed_
 		gen++;
 	}
 	
+	INSTRUMENT_LEAVE ();
+	
 	if (GoLGrid_is_empty (ev_p0))
 		return TRUE;
 	
-	store_object_list (obj_list, obj_cnt, calc_cost (ev_p0), bss);
+	// Many candidates settle into the same debris, so the cost is looked up by the settled pattern first. The cost of an oscillating pattern is always calculated
+	// for the phase with the lower hash, so that it doesn't depend on the phase that the evolution stopped at
+	INSTRUMENT_ENTER (PHASE_SETTLED_HASH);
+	INSTRUMENT_ADD_BYTES (PHASE_SETTLED_HASH, 2 * (get_pop_rect_bytes (ev_p0) + get_pop_rect_bytes (ev_m1)));
+	u64 p0_hash = GoLGrid_get_hash (ev_p0, rda);
+	u64 m1_hash = GoLGrid_get_hash (ev_m1, rda);
+	INSTRUMENT_LEAVE ();
+	
+	const GoLGrid *cost_phase = (m1_hash < p0_hash ? ev_m1 : ev_p0);
+	u64 settled_key = get_settled_key (higher_of_u64 (p0_hash, m1_hash), lower_of_u64 (p0_hash, m1_hash));
+	
+	s32 cost;
+	INSTRUMENT_ENTER (PHASE_COST_CACHE);
+	INSTRUMENT_ADD_BYTES (PHASE_COST_CACHE, CACHE_LINE_BYTES);
+	int was_cached = get_cached_cost (cost_cache, settled_key, &cost);
+	INSTRUMENT_LEAVE ();
+	
+	if (!was_cached)
+	{
+		INSTRUMENT_ENTER (PHASE_CALC_COST);
+		cost = calc_cost (cost_phase);
+		INSTRUMENT_LEAVE ();
+		
+		INSTRUMENT_ENTER (PHASE_COST_CACHE);
+		INSTRUMENT_ADD_BYTES (PHASE_COST_CACHE, CACHE_LINE_BYTES);
+		store_cached_cost (cost_cache, settled_key, cost);
+		INSTRUMENT_LEAVE ();
+	}
+	
+	INSTRUMENT_ENTER (PHASE_POOL_INSERT);
+	INSTRUMENT_ADD_BYTES (PHASE_POOL_INSERT, POOL_RECORD_SIZE);
+	add_pool_candidate (pool_selector, parent_ix, new_obj, cost, settled_key, gen);
+	INSTRUMENT_LEAVE ();
+	
 	return FALSE;
 }
 
@@ -344,9 +1217,11 @@ static s32 gens_until_stable (const GoLGrid *pattern)
 		ev_p0 = temp;
 		
 		GoLGrid_evolve_noinline (ev_m1, ev_p0);
+		INSTRUMENT_ADD_BYTES (PHASE_GENS_UNTIL_STABLE, 4 * get_pop_rect_bytes (ev_p0));
 		gen++;
 	}
 	
+	INSTRUMENT_COUNT (COUNTER_STABILIZATION_GENS, (u64) gen);
 	return gen;
 }
 
@@ -406,8 +1281,11 @@ static void make_early_and_late_grids (const GoLGrid *pattern, s32 last_early_ge
 		ev_p0 = temp;
 		
 		GoLGrid_evolve_noinline (ev_m1, ev_p0);
+		INSTRUMENT_ADD_BYTES (PHASE_EARLY_AND_LATE_GRIDS, 4 * get_pop_rect_bytes (ev_p0));
 		gen++;
 	}
+	
+	INSTRUMENT_COUNT (COUNTER_STABILIZATION_GENS, (u64) gen);
 }
 
 static s32 cost_from_scratch (const AddedObject *obj_list, int obj_cnt, const GoLGrid *problem)
@@ -425,8 +1303,64 @@ static s32 cost_from_scratch (const AddedObject *obj_list, int obj_cnt, const Go
 	return calc_cost (in_setup);
 }
 
-static int add_next_object (AddedObject *obj_list, int in_obj_cnt, const GoLGrid *problem, const GoLGrid *cat_area, const GoLGrid *allowed_area, s32 late_phase_gens,
-		HashTable_u64 *seen_starting_points, HashTable_u64 *tested_setups, const RandomDataArray *rda, ByteSeqStore *out_bss)
+// The mirror images of the allowed area and the catalyst area that are identical to the originals. Mirroring is done within the bounding box of the allowed area,
+// because a starting point is only equivalent to its image if the image has the same position relative to the allowed area. The identity transform is always included
+static void find_symmetries (const GoLGrid *cat_area, const GoLGrid *allowed_area)
+{
+	GoLGrid *image = gg [48];
+	GoLGrid *temp_1 = gg [49];
+	GoLGrid *temp_2 = gg [50];
+	
+	GoLGrid_get_bounding_box (allowed_area, &symmetry_frame);
+	
+	symmetry_cnt = 1;
+	symmetry_transform [0] = 0;
+	
+	int transform;
+	for (transform = 1; transform < 8; transform++)
+	{
+		if ((transform & 4) && symmetry_frame.width != symmetry_frame.height)
+			continue;
+		
+		if (!GoLGrid_transform_within_rect (allowed_area, &symmetry_frame, transform, temp_1, temp_2, image) || !GoLGrid_is_equal_noinline (image, allowed_area))
+			continue;
+		
+		if (!GoLGrid_transform_within_rect (cat_area, &symmetry_frame, transform, temp_1, temp_2, image) || !GoLGrid_is_equal_noinline (image, cat_area))
+			continue;
+		
+		symmetry_transform [symmetry_cnt++] = transform;
+	}
+}
+
+// Equivalent starting points that are mirror images of each other within a symmetric problem get the same key, which is the lowest key of all the images
+static u64 get_starting_point_key (const GoLGrid *starting_point, const GoLGrid *useable_cat_area, const RandomDataArray *rda)
+{
+	GoLGrid *image = gg [48];
+	GoLGrid *temp_1 = gg [49];
+	GoLGrid *temp_2 = gg [50];
+	
+	u64 key = GoLGrid_get_hash_noinline (starting_point, rda) ^ GoLGrid_get_hash_noinline (useable_cat_area, rda);
+	
+	int sym_ix;
+	for (sym_ix = 1; sym_ix < symmetry_cnt; sym_ix++)
+	{
+		if (!GoLGrid_transform_within_rect (starting_point, &symmetry_frame, symmetry_transform [sym_ix], temp_1, temp_2, image))
+			continue;
+		
+		u64 image_key = GoLGrid_get_hash_noinline (image, rda);
+		
+		if (!GoLGrid_transform_within_rect (useable_cat_area, &symmetry_frame, symmetry_transform [sym_ix], temp_1, temp_2, image))
+			continue;
+		
+		image_key ^= GoLGrid_get_hash_noinline (image, rda);
+		key = lower_of_u64 (key, image_key);
+	}
+	
+	return key;
+}
+
+static int add_next_object (AddedObject *obj_list, int in_obj_cnt, s32 parent_ix, const GoLGrid *problem, const GoLGrid *cat_area, const GoLGrid *allowed_area, s32 late_phase_gens,
+		HashTable_u64 *seen_starting_points, TestedSetups *tested_setups, const RandomDataArray *rda, CostCache *cost_cache, PoolSelector *pool_selector)
 {
 	GoLGrid *in_setup = gg [19];
 	GoLGrid *current_objects = gg [20];
@@ -439,8 +1373,8 @@ static int add_next_object (AddedObject *obj_list, int in_obj_cnt, const GoLGrid
 	GoLGrid *must_touch_area = gg [27];
 	GoLGrid *current_objects_p2 = gg [28];
 	GoLGrid *locked_out_area = gg [29];
-	GoLGrid *new_object = gg [30];
 	GoLGrid *new_object_p2 = gg [31];
+	GoLGrid *const *batch_object = &gg [51];
 	GoLGrid *all_objects = gg [32];
 	GoLGrid *setup = gg [33];
 	GoLGrid *result_gg = gg [34];
@@ -449,13 +1383,18 @@ static int add_next_object (AddedObject *obj_list, int in_obj_cnt, const GoLGrid
 	object_list_to_grid (obj_list, in_obj_cnt, current_objects);
 	GoLGrid_or_noinline (in_setup, current_objects);
 	
+	INSTRUMENT_ENTER (PHASE_GENS_UNTIL_STABLE);
 	s32 stable_gen = gens_until_stable (in_setup);
+	INSTRUMENT_LEAVE ();
 	
 	// Needs to be an even number, to add the new object in the right phase
 	s32 last_early_gen = (in_obj_cnt == 0 ? -1 : higher_of_s32 (-1, align_down_s32 (stable_gen - late_phase_gens, 2)));
 	
+	INSTRUMENT_ENTER (PHASE_EARLY_AND_LATE_GRIDS);
 	make_early_and_late_grids (in_setup, last_early_gen, stable_gen, starting_point, early_envelope, late_envelope);
+	INSTRUMENT_LEAVE ();
 	
+	INSTRUMENT_ENTER (PHASE_SETUP_AREAS);
 	GoLGrid_bleed_8_noinline (early_envelope, area_temp);
 	GoLGrid_bleed_4_noinline (area_temp, forbidden_area);
 	
@@ -464,139 +1403,175 @@ static int add_next_object (AddedObject *obj_list, int in_obj_cnt, const GoLGrid
 	
 	GoLGrid_and_noinline (cat_area, must_touch_area, useable_cat_area);
 	GoLGrid_subtract_noinline (useable_cat_area, forbidden_area);
+	INSTRUMENT_LEAVE ();
 	
-	u64 seen_hash = GoLGrid_get_hash_noinline (starting_point, rda) ^ GoLGrid_get_hash_noinline (useable_cat_area, rda);
+	INSTRUMENT_ENTER (PHASE_STARTING_POINTS);
+	INSTRUMENT_ADD_BYTES (PHASE_STARTING_POINTS, CACHE_LINE_BYTES);
 	int was_present;
-	HashTable_u64_store (seen_starting_points, seen_hash, 0, FALSE, &was_present);
+	HashTable_u64_store (seen_starting_points, get_starting_point_key (starting_point, useable_cat_area, rda), 0, FALSE, &was_present);
+	INSTRUMENT_LEAVE ();
+	
 	if (was_present)
 		return FALSE;
 	
+	INSTRUMENT_ENTER (PHASE_SETUP_AREAS);
 	GoLGrid_evolve_noinline (current_objects, current_objects_p2);
 	GoLGrid_or_noinline (current_objects_p2, current_objects);
 	
 	GoLGrid_bleed_8_noinline (current_objects_p2, area_temp);
 	GoLGrid_bleed_4_noinline (area_temp, locked_out_area);
 	
-	s32 new_object_ix;
-	for (new_object_ix = 0; new_object_ix < poss_object_cnt; new_object_ix++)
+	INSTRUMENT_LEAVE ();
+	
+	u64 current_objects_key = get_object_list_key (obj_list, in_obj_cnt);
+	
+	s32 candidate_object_ix [SETUP_BATCH_SIZE];
+	u64 candidate_key [SETUP_BATCH_SIZE];
+	int candidate_was_tested [SETUP_BATCH_SIZE];
+	
+	s32 new_object_ix = 0;
+	while (new_object_ix < poss_object_cnt)
 	{
-		obj_list [in_obj_cnt].object_type = poss_object [new_object_ix].object_type;
-		obj_list [in_obj_cnt].left_x = poss_object [new_object_ix].left_x;
-		obj_list [in_obj_cnt].top_y = poss_object [new_object_ix].top_y;
-		
-		object_list_to_grid (&obj_list [in_obj_cnt], 1, new_object);
-		GoLGrid_evolve_noinline (new_object, new_object_p2);
-		GoLGrid_or_noinline (new_object_p2, new_object);
-		
-		if (!(GoLGrid_are_disjoint_noinline (new_object_p2, forbidden_area)))
-			continue;
-		
-		if (GoLGrid_are_disjoint_noinline (new_object_p2, must_touch_area))
-			continue;
-		
-		if (!(GoLGrid_are_disjoint_noinline (new_object_p2, locked_out_area)))
-			continue;
+		// Collect a batch of objects that can be added, so that the lookups of their object sets in tested_setups can overlap
+		INSTRUMENT_ENTER (PHASE_CANDIDATE_FILTER);
 		
-		GoLGrid_copy_noinline (new_object, all_objects);
-		GoLGrid_or_noinline (all_objects, current_objects);
+		int candidate_cnt = 0;
+		while (new_object_ix < poss_object_cnt && candidate_cnt < SETUP_BATCH_SIZE)
+		{
+			s32 object_ix = new_object_ix++;
+			
+			obj_list [in_obj_cnt].object_type = poss_object [object_ix].object_type;
+			obj_list [in_obj_cnt].left_x = poss_object [object_ix].left_x;
+			obj_list [in_obj_cnt].top_y = poss_object [object_ix].top_y;
+			
+			// The new object is made in the next free grid of the batch, and only kept there if it passes the checks
+			GoLGrid *new_object = batch_object [candidate_cnt];
+			object_list_to_grid (&obj_list [in_obj_cnt], 1, new_object);
+			GoLGrid_evolve_noinline (new_object, new_object_p2);
+			GoLGrid_or_noinline (new_object_p2, new_object);
+			
+			// The new object is evolved, and then compared with up to three areas
+			INSTRUMENT_ADD_BYTES (PHASE_CANDIDATE_FILTER, 10 * get_pop_rect_bytes (new_object_p2));
+			
+			if (!(GoLGrid_are_disjoint_noinline (new_object_p2, forbidden_area)))
+				continue;
+			
+			if (GoLGrid_are_disjoint_noinline (new_object_p2, must_touch_area))
+				continue;
+			
+			if (!(GoLGrid_are_disjoint_noinline (new_object_p2, locked_out_area)))
+				continue;
+			
+			candidate_object_ix [candidate_cnt] = object_ix;
+			candidate_key [candidate_cnt] = current_objects_key ^ poss_object_key [object_ix];
+			candidate_cnt++;
+		}
 		
-		u64 objects_hash = GoLGrid_get_hash_noinline (all_objects, rda);
-		HashTable_u64_store (tested_setups, objects_hash, 0, FALSE, &was_present);
-		if (was_present)
-			continue;
+		INSTRUMENT_LEAVE ();
 		
-		GoLGrid_copy_noinline (starting_point, setup);
-		GoLGrid_or_noinline (setup, new_object);
+		INSTRUMENT_ENTER (PHASE_TESTED_SETUPS);
+		INSTRUMENT_ADD_BYTES (PHASE_TESTED_SETUPS, CACHE_LINE_BYTES * (u64) candidate_cnt);
+		INSTRUMENT_COUNT (COUNTER_TESTED_SETUP_LOOKUPS, (u64) candidate_cnt);
+		store_tested_setups_batch (tested_setups, candidate_key, candidate_cnt, candidate_was_tested);
+		INSTRUMENT_LEAVE ();
 		
-		if (run_setup (setup, allowed_area, obj_list, in_obj_cnt + 1, out_bss))
+		int candidate_ix;
+		for (candidate_ix = 0; candidate_ix < candidate_cnt; candidate_ix++)
 		{
-			printf ("Found a solution:\n\n");
+			if (candidate_was_tested [candidate_ix])
+				continue;
 			
-			GoLGrid_copy_noinline (in_setup, result_gg);
-			GoLGrid_or_noinline (result_gg, new_object);
+			INSTRUMENT_ENTER (PHASE_SETUP_CONSTRUCTION);
 			
-			GoLGrid_print_life_history_full (NULL, NULL, result_gg, all_objects, NULL, NULL);
-			printf ("\n");
+			s32 object_ix = candidate_object_ix [candidate_ix];
+			obj_list [in_obj_cnt].object_type = poss_object [object_ix].object_type;
+			obj_list [in_obj_cnt].left_x = poss_object [object_ix].left_x;
+			obj_list [in_obj_cnt].top_y = poss_object [object_ix].top_y;
 			
-			int obj_ix;
-			for (obj_ix = 1; obj_ix < in_obj_cnt + 1; obj_ix++)
-				printf ("Cost with first %2d objects: %4d\n", obj_ix, cost_from_scratch (obj_list, obj_ix, problem));
+			const GoLGrid *new_object = batch_object [candidate_ix];
+			GoLGrid_copy_noinline (starting_point, setup);
+			GoLGrid_or_noinline (setup, new_object);
 			
-			return TRUE;
+			INSTRUMENT_ADD_BYTES (PHASE_SETUP_CONSTRUCTION, 2 * get_pop_rect_bytes (setup));
+			INSTRUMENT_LEAVE ();
+			
+			int trace_setup = Trace_sample (&trace);
+			double trace_start = (trace_setup ? Trace_start_span (&trace) : 0.0);
+			
+			int solved = run_setup (setup, allowed_area, parent_ix, &obj_list [in_obj_cnt], rda, cost_cache, pool_selector);
+			
+			if (trace_setup)
+				Trace_add_span (&trace, "run_setup", "setup", trace_start, object_ix);
+			
+			if (solved)
+			{
+				printf ("Found a solution:\n\n");
+				
+				GoLGrid_copy_noinline (new_object, all_objects);
+				GoLGrid_or_noinline (all_objects, current_objects);
+				
+				GoLGrid_copy_noinline (in_setup, result_gg);
+				GoLGrid_or_noinline (result_gg, new_object);
+				
+				GoLGrid_print_life_history_full (NULL, NULL, result_gg, all_objects, NULL, NULL);
+				printf ("\n");
+				
+				int obj_ix;
+				for (obj_ix = 1; obj_ix < in_obj_cnt + 1; obj_ix++)
+					printf ("Cost with first %2d objects: %4d\n", obj_ix, cost_from_scratch (obj_list, obj_ix, problem));
+				
+				return TRUE;
+			}
 		}
 	}
 	
 	return FALSE;
 }
 
-static void count_cost_slots (const ByteSeqStore *bss, s32 cost_cnt [])
+// Makes the next level of the pool tree from the candidates selected by sel
+static int make_pool_level (PoolSelector *sel, PoolTree *tree)
 {
-	ByteSeqStoreNode *bss_node;
-	s32 node_data_offset;
-	ByteSeqStore_start_get_iteration (bss, &bss_node, &node_data_offset);
+	double trace_start = Trace_start_span (&trace);
+	INSTRUMENT_ENTER (PHASE_POOL_COMPACTION);
+	int compacted = compact_pool_candidates (sel);
+	INSTRUMENT_LEAVE ();
+	Trace_add_span (&trace, "make_pool_level", "pool", trace_start, sel->kept.seq_count);
+	
+	if (!compacted)
+		return FALSE;
+	
+	s32 node_cnt = (s32) sel->kept.seq_count;
+	PoolTreeNode *level = add_pool_tree_level (tree, node_cnt);
+	if (!level)
+		return FALSE;
 	
-	while (TRUE)
-	{
-		u8 byte_seq [MAX_BYTE_SEQ_SIZE];
-		if (!ByteSeqStore_get_next (bss, &bss_node, &node_data_offset, byte_seq, MAX_BYTE_SEQ_SIZE, NULL))
-			break;
-		
-		cost_cnt [get_cost (byte_seq)]++;
-	}
-}
-
-static void filter_bss (const ByteSeqStore *in_bss, ByteSeqStore *out_bss, s32 cost_limit, s32 patterns_on_cost_limit, s32 use_on_cost_limit)
-{
 	ByteSeqStoreNode *bss_node;
 	s32 node_data_offset;
-	ByteSeqStore_start_get_iteration (in_bss, &bss_node, &node_data_offset);
+	ByteSeqStore_start_get_iteration (&sel->kept, &bss_node, &node_data_offset);
 	
-	while (TRUE)
+	s32 node_ix;
+	for (node_ix = 0; node_ix < node_cnt; node_ix++)
 	{
-		u8 byte_seq [MAX_BYTE_SEQ_SIZE];
-		s32 seq_size;
-		if (!ByteSeqStore_get_next (in_bss, &bss_node, &node_data_offset, byte_seq, MAX_BYTE_SEQ_SIZE, &seq_size))
-			break;
-		
-		s32 cost = get_cost (byte_seq);
-		if (cost > cost_limit)
-			continue;
-		
-		if (cost == cost_limit)
-		{
-			double prob = (double) use_on_cost_limit / (double) patterns_on_cost_limit;
-			double rand = (double) random_u64 () / 18446744073709551616.0;
-			
-			patterns_on_cost_limit--;
-			if (rand >= prob)
-				continue;
-			
-			use_on_cost_limit--;
-		}
-		
-		ByteSeqStore_store (out_bss, byte_seq, seq_size);
+		const u8 *byte_seq;
+		ByteSeqStore_get_next_view (&sel->kept, &bss_node, &node_data_offset, &byte_seq, NULL);
+		get_pool_record (byte_seq, &level [node_ix]);
 	}
+	
+	return TRUE;
 }
 
-static void print_family_statistics (const ByteSeqStore *bss, int first_obj_cnt, const RandomDataArray *rda)
+static void print_family_statistics (const PoolTree *tree, int level_ix, int first_obj_cnt, const RandomDataArray *rda)
 {
 	GoLGrid *first_objects = gg [35];
 	
 	HashTable_u64 count_first_obj;
-	HashTable_u64_create (&count_first_obj, 64, 0.7, 0.9);
-	
-	ByteSeqStoreNode *bss_node;
-	s32 node_data_offset;
-	ByteSeqStore_start_get_iteration (bss, &bss_node, &node_data_offset);
+	HashTable_u64_create (&count_first_obj, 64, 0.7, 0.9, 0);
 	
-	while (TRUE)
+	s32 node_ix;
+	for (node_ix = 0; node_ix < tree->level_size [level_ix]; node_ix++)
 	{
-		u8 byte_seq [MAX_BYTE_SEQ_SIZE];
-		if (!ByteSeqStore_get_next (bss, &bss_node, &node_data_offset, byte_seq, MAX_BYTE_SEQ_SIZE, NULL))
-			break;
-		
 		AddedObject obj_list [MAX_MAX_OBJECTS];
-		get_object_list (byte_seq, obj_list);
+		get_object_list (tree, level_ix, node_ix, obj_list);
 		object_list_to_grid (obj_list, first_obj_cnt, first_objects);
 		
 		u64 hash = GoLGrid_get_hash_noinline (first_objects, rda);
@@ -606,16 +1581,10 @@ static void print_family_statistics (const ByteSeqStore *bss, int first_obj_cnt,
 		HashTable_u64_store (&count_first_obj, hash, count + 1, TRUE, NULL);
 	}
 	
-	ByteSeqStore_start_get_iteration (bss, &bss_node, &node_data_offset);
-	
-	while (TRUE)
+	for (node_ix = 0; node_ix < tree->level_size [level_ix]; node_ix++)
 	{
-		u8 byte_seq [MAX_BYTE_SEQ_SIZE];
-		if (!ByteSeqStore_get_next (bss, &bss_node, &node_data_offset, byte_seq, MAX_BYTE_SEQ_SIZE, NULL))
-			break;
-		
 		AddedObject obj_list [MAX_MAX_OBJECTS];
-		get_object_list (byte_seq, obj_list);
+		get_object_list (tree, level_ix, node_ix, obj_list);
 		object_list_to_grid (obj_list, first_obj_cnt, first_objects);
 		
 		u64 hash = GoLGrid_get_hash_noinline (first_objects, rda);
@@ -636,47 +1605,79 @@ static void print_family_statistics (const ByteSeqStore *bss, int first_obj_cnt,
 		HashTable_u64_store (&count_first_obj, hash, 0, TRUE, NULL);
 	}
 	
-	HashTable_u64_free (&count_first_obj);
+	HashTable_u64_free (&count_first_obj);
+}
+
+// Returns the index of the first pattern with the lowest cost in a level of the pool tree
+static s32 get_lowest_cost_ix (const PoolTree *tree, int level_ix)
+{
+	const PoolTreeNode *level = tree->level [level_ix];
+	
+	s32 lowest_ix = 0;
+	s32 node_ix;
+	for (node_ix = 1; node_ix < tree->level_size [level_ix]; node_ix++)
+		if (level [node_ix].cost < level [lowest_ix].cost)
+			lowest_ix = node_ix;
+	
+	return lowest_ix;
+}
+
+// Prints the problem with the added objects of a pattern in the pool tree, where the objects are marked
+static void print_intermediate (FILE *stream, const PoolTree *tree, int level_ix, s32 node_ix, const GoLGrid *problem)
+{
+	GoLGrid *objects_gg = gg [36];
+	GoLGrid *show_gg = gg [37];
+	
+	AddedObject obj_list [MAX_MAX_OBJECTS];
+	int obj_cnt = get_object_list (tree, level_ix, node_ix, obj_list);
+	object_list_to_grid (obj_list, obj_cnt, objects_gg);
+	
+	GoLGrid_copy_noinline (problem, show_gg);
+	GoLGrid_or_noinline (show_gg, objects_gg);
+	
+	GoLGrid_print_life_history_full (stream, NULL, show_gg, objects_gg, NULL, NULL);
+}
+
+static void print_lowest_cost (const PoolTree *tree, int level_ix, const GoLGrid *problem)
+{
+	s32 node_ix = get_lowest_cost_ix (tree, level_ix);
+	
+	fprintf (stderr, "Lowest cost (%d) intermediate:\n\n", (int) tree->level [level_ix] [node_ix].cost);
+	print_intermediate (stderr, tree, level_ix, node_ix, problem);
+	fprintf (stderr, "\n");
 }
 
-static void print_lowest_cost (const ByteSeqStore *bss, const GoLGrid *problem)
+// Replaces filename with temp_filename in one step, so that a reader never sees a partly written file
+static void replace_file (const char *temp_filename, const char *filename)
 {
-	GoLGrid *objects_gg = gg [36];
-	GoLGrid *show_gg = gg [37];
-	
-	ByteSeqStoreNode *bss_node;
-	s32 node_data_offset;
-	u8 byte_seq [MAX_BYTE_SEQ_SIZE];
-	ByteSeqStore_start_get_iteration (bss, &bss_node, &node_data_offset);
+#ifdef _WIN32
+	// rename fails on Windows if filename exists, and removing it first would leave a moment when there is no file
+	MoveFileExA (temp_filename, filename, MOVEFILE_REPLACE_EXISTING);
+#else
+	rename (temp_filename, filename);
+#endif
+}
+
+// Writes the lowest cost pattern in a level of the pool tree to filename, as a LifeHistory RLE file. The length of filename must be at most MAX_FILENAME_SIZE
+static void write_best_file (const char *filename, const PoolTree *tree, int level_ix, const GoLGrid *problem)
+{
+	char temp_filename [MAX_FILENAME_SIZE + 16];
+	sprintf (temp_filename, "%s.tmp", filename);
 	
-	s32 min_cost = COST_OFF;
-	while (TRUE)
+	FILE *best_file = fopen (temp_filename, "w");
+	if (!best_file)
 	{
-		if (!ByteSeqStore_get_next (bss, &bss_node, &node_data_offset, byte_seq, MAX_BYTE_SEQ_SIZE, NULL))
-			break;
-		
-		min_cost = lower_of_s32 (min_cost, get_cost (byte_seq));
+		fprintf (stderr, "Failed to write best pattern file %s\n", temp_filename);
+		return;
 	}
 	
-	ByteSeqStore_start_get_iteration (bss, &bss_node, &node_data_offset);
-	while (TRUE)
-	{
-		if (!ByteSeqStore_get_next (bss, &bss_node, &node_data_offset, byte_seq, MAX_BYTE_SEQ_SIZE, NULL))
-			break;
-		
-		if (get_cost (byte_seq) == min_cost)
-		{
-			GoLGrid_copy_noinline (problem, show_gg);
-			byte_seq_to_grid (byte_seq, objects_gg);
-			GoLGrid_or_noinline (show_gg, objects_gg);
-			
-			fprintf (stderr, "Lowest cost (%d) intermediate:\n\n", min_cost);
-			GoLGrid_print_life_history_full (stderr, NULL, show_gg, objects_gg, NULL, NULL);
-			fprintf (stderr, "\n");
-			
-			break;
-		}
-	}
+	s32 node_ix = get_lowest_cost_ix (tree, level_ix);
+	
+	fprintf (best_file, "#C Lowest cost (%d) intermediate with %d added objects\n", (int) tree->level [level_ix] [node_ix].cost, level_ix);
+	print_intermediate (best_file, tree, level_ix, node_ix, problem);
+	fclose (best_file);
+	
+	replace_file (temp_filename, filename);
 }
 
 static void make_poss_objects (const GoLGrid *cat_area, int *use_object_type)
@@ -709,6 +1710,7 @@ static void make_poss_objects (const GoLGrid *cat_area, int *use_object_type)
 						poss_object [poss_object_cnt].object_type = obj_ix;
 						poss_object [poss_object_cnt].left_x = x_ix;
 						poss_object [poss_object_cnt].top_y = y_ix;
+						poss_object_key [poss_object_cnt] = get_object_key (obj_ix, x_ix, y_ix);
 						poss_object_cnt++;
 					}
 				}
@@ -869,17 +1871,461 @@ static s32 preprocess_spec (const GoLGrid *problem, GoLGrid *cat_area)
 	return GoLGrid_get_population_noinline (removed_cat_area);
 }
 
+static void start_bench_round (BenchStats *bs)
+{
+	bs->round_start_time = get_wall_seconds ();
+	bs->round_start_outcome_cnt [0] = settled;
+	bs->round_start_outcome_cnt [1] = out_of_bounds;
+	bs->round_start_outcome_cnt [2] = lasted_too_long;
+	bs->round_start_gens = simulated_gens;
+	PerfCounters_read (&bs->perf, &bs->round_start_perf);
+}
+
+static void start_bench (BenchStats *bs, int use_perf_counters)
+{
+	if (use_perf_counters)
+		PerfCounters_create (&bs->perf, TRUE);
+	else
+		PerfCounters_preinit (&bs->perf);
+	
+	bs->start_time = get_wall_seconds ();
+	bs->total_candidate_cnt = 0;
+	bs->round_cnt = 0;
+	start_bench_round (bs);
+	bs->start_perf = bs->round_start_perf;
+}
+
+// The summary lines start with "bench" and consist of key=value pairs, so that they are easy to pick out of the output and compare between runs
+static void end_bench_round (BenchStats *bs, int obj_cnt, s64 candidate_cnt)
+{
+	double seconds = get_wall_seconds () - bs->round_start_time;
+	PerfCounterValues perf;
+	PerfCounters_read (&bs->perf, &perf);
+	
+	u64 settled_cnt = settled - bs->round_start_outcome_cnt [0];
+	u64 out_of_bounds_cnt = out_of_bounds - bs->round_start_outcome_cnt [1];
+	u64 lasted_too_long_cnt = lasted_too_long - bs->round_start_outcome_cnt [2];
+	u64 setup_cnt = settled_cnt + out_of_bounds_cnt + lasted_too_long_cnt;
+	
+	printf ("bench_round objects=%d seconds=%.3f setups=%" PRIu64 " candidates=%" PRId64 " generations=%" PRIu64 " settled=%" PRIu64 " out_of_bounds=%" PRIu64
+			" lasted_too_long=%" PRIu64 " setups_per_s=%.0f", obj_cnt, seconds, setup_cnt, candidate_cnt, simulated_gens - bs->round_start_gens, settled_cnt,
+			out_of_bounds_cnt, lasted_too_long_cnt, (seconds > 0.0 ? (double) setup_cnt / seconds : 0.0));
+	
+	PerfCounters_print_delta (stdout, &bs->perf, &bs->round_start_perf, &perf, "gen", simulated_gens - bs->round_start_gens);
+	printf ("\n");
+	
+	bs->total_candidate_cnt += candidate_cnt;
+	bs->round_cnt++;
+	start_bench_round (bs);
+}
+
+static void print_bench_summary (const BenchStats *bs, const SearchOptions *opt, const char *const *param, const char *result)
+{
+	double seconds = get_wall_seconds () - bs->start_time;
+	PerfCounterValues perf;
+	PerfCounters_read (&bs->perf, &perf);
+	
+	u64 setup_cnt = settled + out_of_bounds + lasted_too_long;
+	double per_setup = (setup_cnt != 0 ? 100.0 / (double) setup_cnt : 0.0);
+	
+	printf ("bench_total problem=%s objects=%s pool=%s max_objects=%s seed=%" PRIu64 " rounds=%d result=%s seconds=%.3f setups=%" PRIu64 " setups_per_s=%.0f candidates=%"
+			PRId64 " candidates_per_s=%.0f generations=%" PRIu64 " generations_per_s=%.0f settled_pct=%.2f out_of_bounds_pct=%.2f lasted_too_long_pct=%.2f", param [0],
+			param [1], param [2], param [3], opt->seed, bs->round_cnt, result, seconds, setup_cnt, (seconds > 0.0 ? (double) setup_cnt / seconds : 0.0), bs->total_candidate_cnt,
+			(seconds > 0.0 ? (double) bs->total_candidate_cnt / seconds : 0.0), simulated_gens, (seconds > 0.0 ? (double) simulated_gens / seconds : 0.0),
+			per_setup * (double) settled, per_setup * (double) out_of_bounds, per_setup * (double) lasted_too_long);
+	
+	PerfCounters_print_delta (stdout, &bs->perf, &bs->start_perf, &perf, "gen", simulated_gens);
+	printf ("\n");
+}
+
+// Returns the resident memory of the process in bytes, or -1 if that isn't known
+static s64 get_resident_memory_size (void)
+{
+	FILE *status_file = fopen ("/proc/self/status", "r");
+	if (!status_file)
+		return -1;
+	
+	s64 size = -1;
+	char line [256];
+	while (fgets (line, sizeof (line), status_file))
+	{
+		long long size_kb;
+		if (sscanf (line, "VmRSS: %lld kB", &size_kb) == 1)
+		{
+			size = 1024 * (s64) size_kb;
+			break;
+		}
+	}
+	
+	fclose (status_file);
+	return size;
+}
+
+static int start_progress (ProgressStatus *ps, u32 interval, const char *filename)
+{
+	if (filename && strlen (filename) > MAX_FILENAME_SIZE)
+	{
+		fprintf (stderr, "Filename too long\n");
+		return FALSE;
+	}
+	
+	ps->interval = (double) interval;
+	ps->filename = filename;
+	if (filename)
+		sprintf (ps->temp_filename, "%s.tmp", filename);
+	
+	ps->start_time = get_wall_seconds ();
+	ps->round_start_time = ps->start_time;
+	ps->next_report_time = ps->start_time + ps->interval;
+	ps->round_start_gens = simulated_gens;
+	ps->round_start_setup_cnt = settled + out_of_bounds + lasted_too_long;
+	return TRUE;
+}
+
+static void start_progress_round (ProgressStatus *ps)
+{
+	ps->round_start_time = get_wall_seconds ();
+	ps->round_start_gens = simulated_gens;
+	ps->round_start_setup_cnt = settled + out_of_bounds + lasted_too_long;
+}
+
+static void write_status_file (const ProgressStatus *ps, const char *state, double now, int obj_cnt, int max_obj_cnt, s32 parent_done_cnt, s32 parent_cnt, double eta,
+		const PoolSelector *sel, const TestedSetups *ts, const CostCache *cc, s64 resident_size)
+{
+	FILE *status_file = fopen (ps->temp_filename, "w");
+	if (!status_file)
+	{
+		fprintf (stderr, "Failed to write status file %s\n", ps->temp_filename);
+		return;
+	}
+	
+	double round_seconds = now - ps->round_start_time;
+	double per_second = (round_seconds > 0.0 ? 1.0 / round_seconds : 0.0);
+	u64 tested_setup_cnt = (ts->use_filter ? ts->filter.used_capacity : ts->table.used_capacity);
+	u64 tested_setups_size = get_tested_setups_memory_size (ts);
+	
+	fprintf (status_file, "{\"state\":\"%s\",\"seconds\":%.1f,\"round\":%d,\"max_objects\":%d,\"parents_done\":%d,\"parents\":%d,\"round_seconds\":%.1f,"
+			"\"round_eta_seconds\":%.1f,\"candidates\":%" PRId64 ",\"candidates_per_s\":%.0f,\"setups_per_s\":%.0f,\"generations_per_s\":%.0f,\"pool_kept\":%"
+			PRId64 ",\"max_pool_size\":%d,\"tested_setups\":%" PRIu64 ",\"tested_setups_bytes\":%" PRIu64 ",\"cost_cache_entries\":%" PRIu64
+			",\"cost_cache_bytes\":%" PRIu64 ",\"resident_bytes\":%" PRId64 "}\n", state, now - ps->start_time, obj_cnt, max_obj_cnt, (int) parent_done_cnt,
+			(int) parent_cnt, round_seconds, eta, sel->total_candidate_cnt, per_second * (double) sel->total_candidate_cnt,
+			per_second * (double) (settled + out_of_bounds + lasted_too_long - ps->round_start_setup_cnt), per_second * (double) (simulated_gens - ps->round_start_gens),
+			sel->kept.seq_count, (int) sel->max_pool_size, tested_setup_cnt, tested_setups_size, cc->table.used_capacity, HashTable_u64_memory_size (&cc->table),
+			resident_size);
+	
+	fclose (status_file);
+	replace_file (ps->temp_filename, ps->filename);
+}
+
+// Prints a status line and updates the status file, if interval seconds have passed since the last time, or if state is not "running". The ETA is extrapolated from
+// the time per parent pattern so far in the round
+static void report_progress (ProgressStatus *ps, const char *state, int obj_cnt, int max_obj_cnt, s32 parent_done_cnt, s32 parent_cnt, const PoolSelector *sel,
+		const TestedSetups *ts, const CostCache *cc)
+{
+	double now = get_wall_seconds ();
+	int running = (strcmp (state, "running") == 0);
+	if (running && now < ps->next_report_time)
+		return;
+	
+	ps->next_report_time = now + ps->interval;
+	
+	double round_seconds = now - ps->round_start_time;
+	double eta = (parent_done_cnt > 0 ? round_seconds * (double) (parent_cnt - parent_done_cnt) / (double) parent_done_cnt : 0.0);
+	s64 resident_size = get_resident_memory_size ();
+	
+	if (running)
+	{
+		double per_second = (round_seconds > 0.0 ? 1.0 / round_seconds : 0.0);
+		
+		fprintf (stderr, "Status: round %d/%d, parents %d/%d, %.0f setups/s, %.2fM generations/s, %.0f candidates/s, pool %d/%d, %.1f MB resident, round ETA %.0f s\n",
+				obj_cnt, max_obj_cnt, (int) parent_done_cnt, (int) parent_cnt, per_second * (double) (settled + out_of_bounds + lasted_too_long - ps->round_start_setup_cnt),
+				1e-6 * per_second * (double) (simulated_gens - ps->round_start_gens), per_second * (double) sel->total_candidate_cnt, (int) sel->kept.seq_count,
+				(int) sel->max_pool_size, (resident_size >= 0 ? (double) resident_size / 1048576.0 : 0.0), eta);
+	}
+	
+	if (ps->filename)
+		write_status_file (ps, state, now, obj_cnt, max_obj_cnt, parent_done_cnt, parent_cnt, eta, sel, ts, cc, resident_size);
+}
+
+// Reports the instrumentation of a round, and starts counting the next one. This does nothing unless compiled with -D __INSTRUMENT
+static void end_instrumented_round (int obj_cnt)
+{
+	#ifdef __INSTRUMENT
+		char label [16];
+		sprintf (label, "%d", obj_cnt);
+		
+		Instrument_report (&instrument, label);
+		
+		PerfCounterValues perf;
+		PerfCounters_read (&instrument_perf, &perf);
+		
+		fprintf (stderr, "Hardware counters, round %d:", obj_cnt);
+		PerfCounters_print_delta (stderr, &instrument_perf, &instrument_perf_round_start, &perf, "gen", simulated_gens - instrument_round_start_gens);
+		fprintf (stderr, "\n");
+		
+		Instrument_start_round (&instrument);
+		PerfCounters_read (&instrument_perf, &instrument_perf_round_start);
+		instrument_round_start_gens = simulated_gens;
+	#else
+		(void) obj_cnt;
+	#endif
+}
+
+static void print_usage (void)
+{
+	fprintf (stderr, "USAGE:   destroy [options] <pattern file> <objects> <max pool size> <max objects>\n");
+	fprintf (stderr, "example: destroy demonoid.rle 124 5000 32\n");
+	fprintf (stderr, "<objects> is a digit for each type of object to be used:\n");
+	fprintf (stderr, "1 = block, 2 = hive, 3 = blinker, 4 = loaf, 5 = boat\n");
+	fprintf (stderr, "options:\n");
+	fprintf (stderr, "--dedup-mb <MB>  Remember tested object sets in an approximate filter of fixed size,\n");
+	fprintf (stderr, "                 instead of in a hash table that grows without limit\n");
+	fprintf (stderr, "--setups-hint <count>  Make the hash table of tested object sets large enough for <count> sets\n");
+	fprintf (stderr, "                       from the start\n");
+	fprintf (stderr, "--spill-mb <MB>  Write pool candidates to a temporary file when they use more than\n");
+	fprintf (stderr, "                 <MB> megabytes of memory\n");
+	fprintf (stderr, "--cost-cache-mb <MB>  Memory for remembering the costs of settled patterns (default 64,\n");
+	fprintf (stderr, "                      0 turns the cache off)\n");
+	fprintf (stderr, "--seed <number>  Seed for the random choices of the search\n");
+	fprintf (stderr, "--bench  Run a fixed benchmark search and print a summary with bench_round and bench_total\n");
+	fprintf (stderr, "         lines. Without other arguments, this runs demonoid.rle %s %s %s with seed %d\n", "124", BENCH_MAX_POOL_SIZE, BENCH_MAX_OBJECTS, BENCH_SEED);
+	fprintf (stderr, "--mem-limit <MB>  Keep the memory of the growing data structures of the search below <MB>\n");
+	fprintf (stderr, "                  megabytes, by shrinking the cost cache, then remembering tested object\n");
+	fprintf (stderr, "                  sets in an approximate filter, and then reducing the pool size\n");
+	fprintf (stderr, "--time-limit <seconds>  End the search after this time, adapting the pool size of each round\n");
+	fprintf (stderr, "                        to the measured speed, and write the lowest cost intermediate to the\n");
+	fprintf (stderr, "                        best pattern file\n");
+	fprintf (stderr, "--best-file <file>  Write the lowest cost intermediate of each round to <file> (default\n");
+	fprintf (stderr, "                    best.rle with --time-limit)\n");
+	fprintf (stderr, "--status-interval <seconds>  Print a status line with the progress of the current round at this\n");
+	fprintf (stderr, "                              interval (default 10)\n");
+	fprintf (stderr, "--status-file <file>  Also write the status to <file> as JSON, replacing the file each time\n");
+	fprintf (stderr, "--trace <file>  Write a trace of the search that can be opened in ui.perfetto.dev or chrome://tracing\n");
+	fprintf (stderr, "--instrument-json <file>  Also write the per-round instrumentation as JSON lines to <file>.\n");
+	fprintf (stderr, "                           Only available when compiled with -D __INSTRUMENT\n");
+}
+
+static int parse_u32_option (int argc, const char *const *argv, int *arg_ix, u32 *value)
+{
+	if (*arg_ix + 1 >= argc || !str_to_u32 (argv [*arg_ix + 1], value))
+	{
+		fprintf (stderr, "Option %s needs a numeric argument\n", argv [*arg_ix]);
+		return FALSE;
+	}
+	
+	(*arg_ix)++;
+	return TRUE;
+}
+
+static int parse_u64_option (int argc, const char *const *argv, int *arg_ix, u64 *value)
+{
+	if (*arg_ix + 1 >= argc || !str_to_u64 (argv [*arg_ix + 1], value))
+	{
+		fprintf (stderr, "Option %s needs a numeric argument\n", argv [*arg_ix]);
+		return FALSE;
+	}
+	
+	(*arg_ix)++;
+	return TRUE;
+}
+
+// Options can be given anywhere on the command line, all other arguments are returned in param
+static int parse_options (int argc, const char *const *argv, SearchOptions *opt, const char **param, int max_param_cnt, int *param_cnt)
+{
+	opt->dedup_filter_mb = 0;
+	opt->expected_setup_cnt = 0;
+	opt->spill_mb = 0;
+	opt->cost_cache_mb = 64;
+	opt->bench = FALSE;
+	opt->use_seed = FALSE;
+	opt->seed = 0;
+	opt->trace_filename = NULL;
+	opt->status_filename = NULL;
+	opt->status_interval = 10;
+	opt->mem_limit_mb = 0;
+	opt->time_limit = 0;
+	opt->best_filename = NULL;
+	opt->instrument_json_filename = NULL;
+	
+	*param_cnt = 0;
+	
+	int arg_ix;
+	for (arg_ix = 1; arg_ix < argc; arg_ix++)
+	{
+		if (strcmp (argv [arg_ix], "--dedup-mb") == 0)
+		{
+			if (!parse_u32_option (argc, argv, &arg_ix, &opt->dedup_filter_mb))
+				return FALSE;
+		}
+		else if (strcmp (argv [arg_ix], "--setups-hint") == 0)
+		{
+			if (!parse_u64_option (argc, argv, &arg_ix, &opt->expected_setup_cnt))
+				return FALSE;
+		}
+		else if (strcmp (argv [arg_ix], "--spill-mb") == 0)
+		{
+			if (!parse_u32_option (argc, argv, &arg_ix, &opt->spill_mb))
+				return FALSE;
+		}
+		else if (strcmp (argv [arg_ix], "--cost-cache-mb") == 0)
+		{
+			if (!parse_u32_option (argc, argv, &arg_ix, &opt->cost_cache_mb))
+				return FALSE;
+		}
+		else if (strcmp (argv [arg_ix], "--seed") == 0)
+		{
+			if (!parse_u64_option (argc, argv, &arg_ix, &opt->seed))
+				return FALSE;
+			
+			opt->use_seed = TRUE;
+		}
+		else if (strcmp (argv [arg_ix], "--bench") == 0)
+			opt->bench = TRUE;
+		else if (strcmp (argv [arg_ix], "--mem-limit") == 0)
+		{
+			if (!parse_u32_option (argc, argv, &arg_ix, &opt->mem_limit_mb))
+				return FALSE;
+		}
+		else if (strcmp (argv [arg_ix], "--time-limit") == 0)
+		{
+			if (!parse_u32_option (argc, argv, &arg_ix, &opt->time_limit))
+				return FALSE;
+			
+			if (opt->time_limit == 0)
+			{
+				fprintf (stderr, "Option %s needs a value of at least 1\n", argv [arg_ix - 1]);
+				return FALSE;
+			}
+		}
+		else if (strcmp (argv [arg_ix], "--best-file") == 0)
+		{
+			if (arg_ix + 1 >= argc)
+			{
+				fprintf (stderr, "Option %s needs a filename argument\n", argv [arg_ix]);
+				return FALSE;
+			}
+			
+			opt->best_filename = argv [++arg_ix];
+			
+			if (strlen (opt->best_filename) > MAX_FILENAME_SIZE)
+			{
+				fprintf (stderr, "Filename too long\n");
+				return FALSE;
+			}
+		}
+		else if (strcmp (argv [arg_ix], "--status-interval") == 0)
+		{
+			if (!parse_u32_option (argc, argv, &arg_ix, &opt->status_interval))
+				return FALSE;
+			
+			if (opt->status_interval == 0)
+			{
+				fprintf (stderr, "Option %s needs a value of at least 1\n", argv [arg_ix - 1]);
+				return FALSE;
+			}
+		}
+		else if (strcmp (argv [arg_ix], "--status-file") == 0)
+		{
+			if (arg_ix + 1 >= argc)
+			{
+				fprintf (stderr, "Option %s needs a filename argument\n", argv [arg_ix]);
+				return FALSE;
+			}
+			
+			opt->status_filename = argv [++arg_ix];
+		}
+		else if (strcmp (argv [arg_ix], "--trace") == 0)
+		{
+			if (arg_ix + 1 >= argc)
+			{
+				fprintf (stderr, "Option %s needs a filename argument\n", argv [arg_ix]);
+				return FALSE;
+			}
+			
+			opt->trace_filename = argv [++arg_ix];
+		}
+		else if (strcmp (argv [arg_ix], "--instrument-json") == 0)
+		{
+			if (arg_ix + 1 >= argc)
+			{
+				fprintf (stderr, "Option %s needs a filename argument\n", argv [arg_ix]);
+				return FALSE;
+			}
+			
+			#ifndef __INSTRUMENT
+				fprintf (stderr, "Option %s needs a program compiled with -D __INSTRUMENT\n", argv [arg_ix]);
+				return FALSE;
+			#endif
+			
+			opt->instrument_json_filename = argv [++arg_ix];
+		}
+		else if (strncmp (argv [arg_ix], "--", 2) == 0)
+		{
+			fprintf (stderr, "Unknown option %s\n", argv [arg_ix]);
+			return FALSE;
+		}
+		else
+		{
+			if (*param_cnt >= max_param_cnt)
+				return FALSE;
+			
+			param [(*param_cnt)++] = argv [arg_ix];
+		}
+	}
+	
+	return TRUE;
+}
+
 static int main_do (int argc, const char *const *argv)
 {
-	if (argc != 5)
+	SearchOptions opt;
+	const char *param [4];
+	int param_cnt;
+	
+	if (!parse_options (argc, argv, &opt, param, 4, &param_cnt))
+	{
+		print_usage ();
+		return EXIT_FAILURE;
+	}
+	
+	if (opt.bench && param_cnt == 0)
+	{
+		param [0] = "demonoid.rle";
+		param [1] = "124";
+		param [2] = BENCH_MAX_POOL_SIZE;
+		param [3] = BENCH_MAX_OBJECTS;
+		param_cnt = 4;
+	}
+	
+	if (param_cnt != 4)
 	{
-		fprintf (stderr, "USAGE:   destroy <pattern file> <objects> <max pool size> <max objects>\n");
-		fprintf (stderr, "example: destroy demonoid.rle 124 5000 32\n");
-		fprintf (stderr, "<objects> is a digit for each type of object to be used:\n");
-		fprintf (stderr, "1 = block, 2 = hive, 3 = blinker, 4 = loaf, 5 = boat\n");
+		print_usage ();
 		return EXIT_FAILURE;
 	}
 	
+	// A benchmark always uses an explicit seed, so that it does the same work every time
+	if (opt.bench && !opt.use_seed)
+	{
+		opt.seed = BENCH_SEED;
+		opt.use_seed = TRUE;
+	}
+	
+	if (opt.use_seed)
+		random_u64_set_seed (opt.seed, opt.seed ^ 0xcaca61eeae213995u, FALSE);
+	
+	Trace_preinit (&trace);
+	if (opt.trace_filename && !Trace_create (&trace, opt.trace_filename, 1, TRACE_SETUP_SAMPLE_INTERVAL))
+		return EXIT_FAILURE;
+	
+	#ifdef __INSTRUMENT
+		if (!Instrument_create (&instrument, phase_name, PHASE_CNT, counter_name, COUNTER_CNT, opt.instrument_json_filename))
+			return EXIT_FAILURE;
+		
+		PerfCounters_create (&instrument_perf, TRUE);
+		PerfCounters_read (&instrument_perf, &instrument_perf_round_start);
+		instrument_round_start_gens = 0;
+	#endif
+	
 	Rect gr;
 	Rect_make (&gr, -(GRID_SIZE / 2), -(GRID_SIZE / 2), GRID_SIZE, GRID_SIZE);
 	
@@ -894,24 +2340,29 @@ static int main_do (int argc, const char *const *argv)
 	GoLGrid *cat_area = gg [46];
 	GoLGrid *allowed_area = gg [47];
 	
-	if (!parse_spec_file (argv [1], problem, cat_area, allowed_area))
+	if (!parse_spec_file (param [0], problem, cat_area, allowed_area))
 		return EXIT_FAILURE;
 	
 	int use_object_type [OBJECT_TYPE_CNT];
 	
-	if (!parse_object_type (argv [2], use_object_type))
+	if (!parse_object_type (param [1], use_object_type))
 		return EXIT_FAILURE;
 	
 	u32 parm_max_pool_size;
 	u32 parm_max_objects;
 
-	if (!str_to_u32 (argv [3], &parm_max_pool_size))
+	if (!str_to_u32 (param [2], &parm_max_pool_size))
 	{
 		fprintf (stderr, "Illegal <max pool size> parameter\n");
 		return EXIT_FAILURE;
 	}
+	if (parm_max_pool_size < 1 || parm_max_pool_size > s32_MAX / 2)
+	{
+		fprintf (stderr, "<max pool size> must be between 1 and %d\n", s32_MAX / 2);
+		return EXIT_FAILURE;
+	}
 	
-	if (!str_to_u32 (argv [4], &parm_max_objects))
+	if (!str_to_u32 (param [3], &parm_max_objects))
 	{
 		fprintf (stderr, "Illegal <max objects> parameter\n");
 		return EXIT_FAILURE;
@@ -941,78 +2392,188 @@ static int main_do (int argc, const char *const *argv)
 	s32 late_phase_gens = 256;
 	
 	make_poss_objects (cat_area, use_object_type);
-	fprintf (stderr, "\nPossible objects in allowed area: %d\n\n", poss_object_cnt);
+	fprintf (stderr, "\nPossible objects in allowed area: %d\n", poss_object_cnt);
+	
+	find_symmetries (cat_area, allowed_area);
+	if (symmetry_cnt > 1)
+		fprintf (stderr, "The problem has %d symmetries, mirrored starting points are only tested once\n", symmetry_cnt);
+	
+	fprintf (stderr, "\n");
 	
 	RandomDataArray rda;
 	RandomDataArray_create (&rda, gr.height * gr.width / 64);
 	
-	HashTable_u64 tested_setups;
-	HashTable_u64_create (&tested_setups, 64, 0.7, 0.9);
+	TestedSetups tested_setups;
+	if (!create_tested_setups (&tested_setups, ((u64) opt.dedup_filter_mb) << 20, opt.expected_setup_cnt))
+		return EXIT_FAILURE;
+	
+	CostCache cost_cache;
+	if (!create_cost_cache (&cost_cache, ((u64) opt.cost_cache_mb) << 20))
+		return EXIT_FAILURE;
 	
 	HashTable_u64 seen_starting_points;
-	HashTable_u64_create (&seen_starting_points, 64, 0.7, 0.9);
+	HashTable_u64_create (&seen_starting_points, 64, 0.7, 0.9, HASHTABLE_U64_KEYS_ONLY | HASHTABLE_U64_EPOCH_CLEAR);
+	
+	// There is at most one starting point for each pattern in the pool
+	HashTable_u64_reserve (&seen_starting_points, (u64) max_pool_size);
+	
+	PoolTree pool_tree;
+	preinit_pool_tree (&pool_tree);
+	
+	PoolTreeNode *root_level = add_pool_tree_level (&pool_tree, 1);
+	if (!root_level)
+		return EXIT_FAILURE;
 	
-	ByteSeqStore filtered;
-	ByteSeqStore_create (&filtered, 16384);
+	root_level [0].parent_ix = -1;
+	root_level [0].cost = 0;
+	root_level [0].object_type = 0;
+	root_level [0].left_x = 0;
+	root_level [0].top_y = 0;
 	
 	AddedObject obj_list [MAX_MAX_OBJECTS];
-	store_object_list (obj_list, 0, 0, &filtered);
 	
-	ByteSeqStore unfiltered;
-	ByteSeqStore_create (&unfiltered, 16384);
+	PoolSelector pool_selector;
+	if (!create_pool_selector (&pool_selector, max_pool_size, ((s64) opt.spill_mb) << 20))
+		return EXIT_FAILURE;
+	
+	BenchStats bench_stats;
+	start_bench (&bench_stats, opt.bench);
+	const char *bench_result = "max_objects";
+	
+	ProgressStatus progress;
+	if (!start_progress (&progress, opt.status_interval, opt.status_filename))
+		return EXIT_FAILURE;
+	
+	s32 round_parent_cnt = 0;
+	
+	MemoryLimit memory_limit;
+	memory_limit.limit = ((u64) opt.mem_limit_mb) << 20;
+	memory_limit.exhausted = FALSE;
+	memory_limit.waiting = FALSE;
+	memory_limit.step_compaction_cnt = 0;
+	memory_limit.max_pool_size = max_pool_size;
+	
+	if (opt.time_limit != 0 && !opt.best_filename)
+		opt.best_filename = "best.rle";
+	
+	TimeLimit time_limit;
+	time_limit.on = (opt.time_limit != 0);
+	time_limit.expired = FALSE;
+	time_limit.end_time = progress.start_time + (double) opt.time_limit;
+	time_limit.seconds_per_parent = 0.0;
 	
 	int obj_cnt;
 	for (obj_cnt = 1; obj_cnt <= max_added_objects; obj_cnt++)
 	{
 		if (obj_cnt > 1)
-			print_lowest_cost (&filtered, problem);
+			print_lowest_cost (&pool_tree, obj_cnt - 1, problem);
 		
 //		if (obj_cnt > 1)
-//			print_family_statistics (&filtered, 1, &rda);
+//			print_family_statistics (&pool_tree, obj_cnt - 1, 1, &rda);
 		
-		ByteSeqStore_clear (&unfiltered);
+		double round_trace_start = Trace_start_span (&trace);
 		
-		ByteSeqStoreNode *bss_node;
-		s32 node_data_offset;
+		clear_pool_selector (&pool_selector);
+		memory_limit.waiting = FALSE;
+		clear_outcome_gen_histogram ();
+		start_progress_round (&progress);
 		
-		ByteSeqStore_start_get_iteration (&filtered, &bss_node, &node_data_offset);
+		s32 filtered_cnt = pool_tree.level_size [obj_cnt - 1];
+		round_parent_cnt = filtered_cnt;
 		
 		fprintf (stderr, "--- Starting round with %d added objects\n", obj_cnt);
-		fprintf (stderr, "Filtered patterns = %d\n", (int) filtered.seq_count);
+		fprintf (stderr, "Filtered patterns = %d\n", (int) filtered_cnt);
+		
+		adapt_pool_size_to_time_limit (&time_limit, &memory_limit, &pool_selector, max_pool_size, obj_cnt, max_added_objects, filtered_cnt);
 		
 		HashTable_u64_clear (&seen_starting_points);
 		
 		s32 pattern_ix;
-		for (pattern_ix = 0; pattern_ix < filtered.seq_count; pattern_ix++)
+		for (pattern_ix = 0; pattern_ix < filtered_cnt; pattern_ix++)
 		{
 			if (pattern_ix % 1000 == 0)
 				fprintf (stderr, "Testing pattern %d\n", pattern_ix);
 			
-			u8 byte_seq [MAX_BYTE_SEQ_SIZE];
-			ByteSeqStore_get_next (&filtered, &bss_node, &node_data_offset, byte_seq, MAX_BYTE_SEQ_SIZE, NULL);
+			get_object_list (&pool_tree, obj_cnt - 1, pattern_ix, obj_list);
+			
+			double parent_trace_start = Trace_start_span (&trace);
+			int solved = add_next_object (obj_list, obj_cnt - 1, pattern_ix, problem, cat_area, allowed_area, late_phase_gens, &seen_starting_points, &tested_setups, &rda,
+					&cost_cache, &pool_selector);
+			Trace_add_span (&trace, "add_next_object", "parent", parent_trace_start, pattern_ix);
 			
-			get_object_list (byte_seq, obj_list);
-			if (add_next_object (obj_list, obj_cnt - 1, problem, cat_area, allowed_area, late_phase_gens, &seen_starting_points, &tested_setups, &rda, &unfiltered))
+			if (solved)
+			{
+				report_progress (&progress, "solution", obj_cnt, max_added_objects, pattern_ix + 1, filtered_cnt, &pool_selector, &tested_setups, &cost_cache);
+				Trace_add_span (&trace, "round", "round", round_trace_start, obj_cnt);
+				Trace_free (&trace);
+				end_instrumented_round (obj_cnt);
+				
+				if (opt.bench)
+				{
+					end_bench_round (&bench_stats, obj_cnt, pool_selector.total_candidate_cnt);
+					print_bench_summary (&bench_stats, &opt, param, "solution");
+				}
+				
 				return EXIT_SUCCESS;
+			}
+			
+			report_progress (&progress, "running", obj_cnt, max_added_objects, pattern_ix + 1, filtered_cnt, &pool_selector, &tested_setups, &cost_cache);
+			
+			if (!enforce_memory_limit (&memory_limit, &pool_tree, &pool_selector, &tested_setups, &cost_cache, &seen_starting_points))
+				return EXIT_FAILURE;
+			
+			if (time_limit.on && get_wall_seconds () >= time_limit.end_time)
+			{
+				fprintf (stderr, "\nTime limit reached after %d of %d patterns\n", pattern_ix + 1, (int) filtered_cnt);
+				time_limit.expired = TRUE;
+				round_parent_cnt = pattern_ix + 1;
+				break;
+			}
+		}
+		
+		if (pool_selector.total_candidate_cnt == 0 && time_limit.expired)
+		{
+			Trace_add_span (&trace, "round", "round", round_trace_start, obj_cnt);
+			end_instrumented_round (obj_cnt);
+			
+			if (opt.bench)
+				end_bench_round (&bench_stats, obj_cnt, 0);
+			
+			obj_cnt--;
+			break;
 		}
 		
-		if (unfiltered.seq_count == 0)
+		if (pool_selector.total_candidate_cnt == 0)
 		{
 			fprintf (stderr, "\nNo continuation found, ending search\n");
+			report_progress (&progress, "no_continuation", obj_cnt, max_added_objects, filtered_cnt, filtered_cnt, &pool_selector, &tested_setups, &cost_cache);
+			Trace_add_span (&trace, "round", "round", round_trace_start, obj_cnt);
+			end_instrumented_round (obj_cnt);
+			
+			if (opt.bench)
+				end_bench_round (&bench_stats, obj_cnt, 0);
+			
+			bench_result = "no_continuation";
 			break;
 		}
 		
-		fprintf (stderr, "Unfiltered patterns: %d\n", (s32) unfiltered.seq_count);
+		// The last duplicates are removed before the costs are reported, so that the reported cost range is the one of the new pool
+		double compact_trace_start = Trace_start_span (&trace);
+		INSTRUMENT_ENTER (PHASE_POOL_COMPACTION);
+		int compacted = compact_pool_candidates (&pool_selector);
+		INSTRUMENT_LEAVE ();
+		Trace_add_span (&trace, "compact_pool_candidates", "pool", compact_trace_start, pool_selector.kept.seq_count);
 		
-		s32 cost_slot [COST_OFF];
-		s32 cost_ix;
-		for (cost_ix = 0; cost_ix < COST_OFF; cost_ix++)
-			cost_slot [cost_ix] = 0;
+		if (!compacted)
+			return EXIT_FAILURE;
 		
-		count_cost_slots (&unfiltered, cost_slot);
+		fprintf (stderr, "Unfiltered patterns: %d, removed as duplicate settled patterns: %d\n", (s32) pool_selector.total_candidate_cnt,
+				(s32) pool_selector.duplicate_candidate_cnt);
+		
+		const s32 *cost_slot = pool_selector.candidate_cnt;
+		s32 cost_ix;
 		
 		s32 lowest_cost = 0;
-		s32 old_pool_size = 0;
 		s32 new_pool_size = 0;
 		int reported = 0;
 		for (cost_ix = 0; cost_ix < COST_OFF; cost_ix++)
@@ -1026,10 +2587,9 @@ static int main_do (int argc, const char *const *argv)
 				reported++;
 			}
 			
-			old_pool_size = new_pool_size;
 			new_pool_size += cost_slot [cost_ix];
 			
-			if (new_pool_size > max_pool_size)
+			if (new_pool_size > pool_selector.max_pool_size)
 				break;
 		}
 		
@@ -1041,11 +2601,66 @@ static int main_do (int argc, const char *const *argv)
 		double ltl = 100.0 * (double) lasted_too_long / sum;
 		
 		fprintf (stderr, "Out of bounds = %.2f%%, settled = %.2f%%, lasted too long = %.2f%%\n", oob, set, ltl);
+		print_outcome_gen_histogram ();
+		print_tested_setups_statistics (&tested_setups);
+		print_cost_cache_statistics (&cost_cache);
+		
+		fprintf (stderr, "Pool tree: %d levels (%.1f MB), kept candidates: %.1f MB", pool_tree.level_cnt, (double) pool_tree.memory_usage / 1048576.0,
+				(double) (pool_selector.kept.memory_usage + pool_selector.compact_temp.memory_usage) / 1048576.0);
+		
+		if (pool_selector.kept.spill)
+			fprintf (stderr, " (%.1f MB spilled to disk)", (double) pool_selector.kept.spilled_size / 1048576.0);
+		
+		fprintf (stderr, "\n");
+		
+		fprintf (stderr, "Tracked memory: %.1f MB", (double) get_search_memory_usage (&pool_tree, &pool_selector, &tested_setups, &cost_cache, &seen_starting_points) /
+				1048576.0);
+		
+		if (memory_limit.limit != 0)
+			fprintf (stderr, " (limit %.1f MB)", (double) memory_limit.limit / 1048576.0);
+		
+		fprintf (stderr, "\n");
 		
-		ByteSeqStore_clear (&filtered);
-		filter_bss (&unfiltered, &filtered, cost_ix, new_pool_size - old_pool_size, max_pool_size - old_pool_size);
+		if (!make_pool_level (&pool_selector, &pool_tree))
+			return EXIT_FAILURE;
+		
+		if (opt.best_filename)
+			write_best_file (opt.best_filename, &pool_tree, obj_cnt, problem);
+		
+		Trace_add_span (&trace, "round", "round", round_trace_start, obj_cnt);
+		end_instrumented_round (obj_cnt);
+		
+		if (opt.bench)
+			end_bench_round (&bench_stats, obj_cnt, pool_selector.total_candidate_cnt);
+		
+		if (time_limit.expired)
+			break;
+		
+		time_limit.seconds_per_parent = (get_wall_seconds () - progress.round_start_time) / (double) filtered_cnt;
+	}
+	
+	if (time_limit.expired)
+	{
+		bench_result = "time_limit";
+		report_progress (&progress, bench_result, obj_cnt, max_added_objects, round_parent_cnt, round_parent_cnt, &pool_selector, &tested_setups, &cost_cache);
+		
+		if (obj_cnt > 0)
+		{
+			print_lowest_cost (&pool_tree, obj_cnt, problem);
+			fprintf (stderr, "Lowest cost intermediate with %d added objects written to %s\n", obj_cnt, opt.best_filename);
+		}
+		else
+			fprintf (stderr, "The time limit was reached before any intermediate was found\n");
 	}
 	
+	if (strcmp (bench_result, "max_objects") == 0)
+		report_progress (&progress, bench_result, max_added_objects, max_added_objects, round_parent_cnt, round_parent_cnt, &pool_selector, &tested_setups, &cost_cache);
+	
+	Trace_free (&trace);
+	
+	if (opt.bench)
+		print_bench_summary (&bench_stats, &opt, param, bench_result);
+	
 	return EXIT_SUCCESS;
 }
 
@@ -133,6 +133,81 @@ static __not_inline int GoLGrid_or_filled_circle (GoLGrid *gg, double cent_x, do
 	return not_clipped;
 }
 
+// Mirrors the pattern in src_gg within frame (in normal coordinates), so that a pattern inside frame is mapped to a pattern inside the same frame. Bit 0 of transform
+// flips horizontally, bit 1 flips vertically and bit 2 flips diagonally, which is done first and requires a square frame. temp_1_gg and temp_2_gg are overwritten
+// Returns FALSE if the pattern is not inside frame
+static __not_inline int GoLGrid_transform_within_rect (const GoLGrid *src_gg, const Rect *frame, int transform, GoLGrid *temp_1_gg, GoLGrid *temp_2_gg, GoLGrid *dst_gg)
+{
+	if (!src_gg || !frame || transform < 0 || transform > 7 || ((transform & 4) && frame->width != frame->height) || !temp_1_gg || !temp_2_gg || !dst_gg)
+		return ffsc (__func__);
+	
+	GoLGrid_set_grid_coords (temp_1_gg, src_gg->grid_rect.left_x, src_gg->grid_rect.top_y);
+	GoLGrid_set_grid_coords (temp_2_gg, src_gg->grid_rect.left_x, src_gg->grid_rect.top_y);
+	GoLGrid_set_grid_coords (dst_gg, src_gg->grid_rect.left_x, src_gg->grid_rect.top_y);
+	
+	Rect bb;
+	if (!GoLGrid_get_bounding_box (src_gg, &bb))
+	{
+		GoLGrid_clear_noinline (dst_gg);
+		return TRUE;
+	}
+	
+	if (!Rect_is_subset (&bb, frame))
+		return FALSE;
+	
+	s32 rel_x = bb.left_x - frame->left_x;
+	s32 rel_y = bb.top_y - frame->top_y;
+	s32 width = bb.width;
+	s32 height = bb.height;
+	
+	// The flip functions require the bounding box to start at physical coordinates (0, 0)
+	GoLGrid_copy_unmatched_noinline (src_gg, temp_1_gg, src_gg->grid_rect.left_x - bb.left_x, src_gg->grid_rect.top_y - bb.top_y);
+	
+	GoLGrid *cur_gg = temp_1_gg;
+	GoLGrid *other_gg = temp_2_gg;
+	GoLGrid *swap_gg;
+	s32 swap_s32;
+	
+	if (transform & 4)
+	{
+		GoLGrid_flip_diagonally_noinline (cur_gg, other_gg);
+		swap_gg = cur_gg;
+		cur_gg = other_gg;
+		other_gg = swap_gg;
+		
+		swap_s32 = rel_x;
+		rel_x = rel_y;
+		rel_y = swap_s32;
+		
+		swap_s32 = width;
+		width = height;
+		height = swap_s32;
+	}
+	
+	if (transform & 1)
+	{
+		GoLGrid_flip_horizontally_noinline (cur_gg, other_gg);
+		swap_gg = cur_gg;
+		cur_gg = other_gg;
+		other_gg = swap_gg;
+		
+		rel_x = frame->width - (rel_x + width);
+	}
+	
+	if (transform & 2)
+	{
+		GoLGrid_flip_vertically_noinline (cur_gg, other_gg);
+		swap_gg = cur_gg;
+		cur_gg = other_gg;
+		other_gg = swap_gg;
+		
+		rel_y = frame->height - (rel_y + height);
+	}
+	
+	GoLGrid_copy_unmatched_noinline (cur_gg, dst_gg, (frame->left_x + rel_x) - dst_gg->grid_rect.left_x, (frame->top_y + rel_y) - dst_gg->grid_rect.top_y);
+	return TRUE;
+}
+
 static __not_inline void GoLGrid_print (const GoLGrid *gg)
 {
 	if (!gg || !gg->grid)
@@ -1,10 +1,33 @@
-typedef struct
-{
-	u64 key;
-	u64 data;
-} HashTable_u64_entry;
+// A hash table for u64 keys with optional u64 data. A key can't be 0, and keys are expected to be good hash values already, so they are used without further mixing
+// The slots are divided into groups of HASHTABLE_U64_GROUP_SIZE slots, each with one control byte per slot. The control byte is either HASHTABLE_U64_EMPTY or the
+// 7 highest bits of the key stored in the slot. A lookup starts at the group selected by the lowest bits of the key, and matches the control bytes of a whole group
+// against the key bits with a single vector compare, so keys are only read for slots with matching control bytes
+// Keys and data are stored in separate arrays. A table created with HASHTABLE_U64_KEYS_ONLY has no data array at all, which is enough for tables that are used as sets
+// A table created with HASHTABLE_U64_EPOCH_CLEAR also has an epoch byte for each slot, and a slot is only in use if its epoch byte is equal to current_epoch. Clearing
+// the table then only has to increment current_epoch, instead of writing all control bytes. This is meant for large tables that are cleared often
+// A table created with HASHTABLE_U64_INCREMENTAL_RESIZE doesn't move all entries to the new slots at once when it grows. The old slots are kept as old_ht, and each call
+// to HashTable_u64_store moves the entries of the next HASHTABLE_U64_MIGRATE_GROUPS groups. Until all entries are moved, a key that isn't found in the new slots is
+// also looked up in old_ht. This avoids long stalls when very large tables grow
+
+#if defined (__AVX2__) && !defined (__NO_AVX2)
+	#define HASHTABLE_U64_GROUP_SIZE 32
+#else
+	#define HASHTABLE_U64_GROUP_SIZE 16
+#endif
+
+#define HASHTABLE_U64_GROUP_MASK ((u32) ((((u64) 1) << HASHTABLE_U64_GROUP_SIZE) - 1))
+
+#define HASHTABLE_U64_EMPTY 0x80
+
+#define HASHTABLE_U64_KEYS_ONLY 0x01
+#define HASHTABLE_U64_EPOCH_CLEAR 0x02
+#define HASHTABLE_U64_INCREMENTAL_RESIZE 0x04
+
+#define HASHTABLE_U64_MIGRATE_GROUPS 4
 
-typedef struct
+typedef struct _HashTable_u64 HashTable_u64;
+
+typedef struct _HashTable_u64
 {
 	double reallocate_filled_part;
 	double fail_filled_part;
@@ -13,7 +36,15 @@ typedef struct
 	u64 fail_capacity;
 	u64 used_capacity;
 	int failed_reallocation;
-	HashTable_u64_entry *table;
+	u32 options;
+	u8 current_epoch;
+	void *ctrl_alloc;
+	u8 *ctrl;
+	u8 *epoch;
+	u64 *key;
+	u64 *data;
+	HashTable_u64 *old_ht;
+	u64 migrate_entry_ix;
 } HashTable_u64;
 
 static __may_inline void HashTable_u64_preinit (HashTable_u64 *ht)
@@ -28,7 +59,94 @@ static __may_inline void HashTable_u64_preinit (HashTable_u64 *ht)
 	ht->fail_capacity = 0;
 	ht->used_capacity = 0;
 	ht->failed_reallocation = FALSE;
-	ht->table = NULL;
+	ht->options = 0;
+	ht->current_epoch = 0;
+	ht->ctrl_alloc = NULL;
+	ht->ctrl = NULL;
+	ht->epoch = NULL;
+	ht->key = NULL;
+	ht->data = NULL;
+	ht->old_ht = NULL;
+	ht->migrate_entry_ix = 0;
+}
+
+// Returns a bit mask with bit n set if the control byte of slot n in the group is equal to ctrl_value
+static __force_inline u32 HashTable_u64_int_match_group (const u8 *group_ctrl, u8 ctrl_value)
+{
+	#if defined (__AVX2__) && !defined (__NO_AVX2)
+		__m256i ctrl_vec = _mm256_load_si256 ((const __m256i *) group_ctrl);
+		return (u32) _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (ctrl_vec, _mm256_set1_epi8 ((char) ctrl_value)));
+	#elif defined (__SSE2__)
+		__m128i ctrl_vec = _mm_load_si128 ((const __m128i *) group_ctrl);
+		return (u32) _mm_movemask_epi8 (_mm_cmpeq_epi8 (ctrl_vec, _mm_set1_epi8 ((char) ctrl_value)));
+	#else
+		u32 match = 0;
+		int slot_ix;
+		for (slot_ix = 0; slot_ix < HASHTABLE_U64_GROUP_SIZE; slot_ix++)
+			if (group_ctrl [slot_ix] == ctrl_value)
+				match |= ((u32) 1) << slot_ix;
+		
+		return match;
+	#endif
+}
+
+static __force_inline u8 HashTable_u64_int_ctrl_value (u64 key)
+{
+	return (u8) (key >> 57);
+}
+
+// Returns TRUE and the slot of the key if it is in the table, otherwise FALSE and the slot where it should be inserted
+static __force_inline int HashTable_u64_int_find (const HashTable_u64 *ht, u64 key, u64 *entry_ix)
+{
+	u64 group_mask = (ht->total_capacity / HASHTABLE_U64_GROUP_SIZE) - 1;
+	u64 group_ix = key & group_mask;
+	u8 ctrl_value = HashTable_u64_int_ctrl_value (key);
+	
+	while (TRUE)
+	{
+		const u8 *group_ctrl = ht->ctrl + (group_ix * HASHTABLE_U64_GROUP_SIZE);
+		
+		u32 match = HashTable_u64_int_match_group (group_ctrl, ctrl_value);
+		u32 current = HASHTABLE_U64_GROUP_MASK;
+		if (ht->epoch)
+		{
+			current = HashTable_u64_int_match_group (ht->epoch + (group_ix * HASHTABLE_U64_GROUP_SIZE), ht->current_epoch);
+			match &= current;
+		}
+		
+		while (match != 0)
+		{
+			u64 match_ix = (group_ix * HASHTABLE_U64_GROUP_SIZE) + (u64) least_significant_bit_u64 (match);
+			if (ht->key [match_ix] == key)
+			{
+				*entry_ix = match_ix;
+				return TRUE;
+			}
+			
+			match &= (match - 1);
+		}
+		
+		u32 empty = (ht->epoch ? ~current & HASHTABLE_U64_GROUP_MASK : HashTable_u64_int_match_group (group_ctrl, HASHTABLE_U64_EMPTY));
+		if (empty != 0)
+		{
+			*entry_ix = (group_ix * HASHTABLE_U64_GROUP_SIZE) + (u64) least_significant_bit_u64 (empty);
+			return FALSE;
+		}
+		
+		group_ix = (group_ix + 1) & group_mask;
+	}
+}
+
+// Starts loading the first group that a lookup of key reads. Slots are filled from the start of a group, so only the first cache line of keys is loaded
+static __force_inline void HashTable_u64_int_prefetch (const HashTable_u64 *ht, u64 key)
+{
+	u64 group_offset = (key & ((ht->total_capacity / HASHTABLE_U64_GROUP_SIZE) - 1)) * HASHTABLE_U64_GROUP_SIZE;
+	
+	prefetch_read (ht->ctrl + group_offset);
+	if (ht->epoch)
+		prefetch_read (ht->epoch + group_offset);
+	
+	prefetch_read (ht->key + group_offset);
 }
 
 static __not_inline void HashTable_u64_free (HashTable_u64 *ht)
@@ -36,37 +154,92 @@ static __not_inline void HashTable_u64_free (HashTable_u64 *ht)
 	if (!ht)
 		return (void) ffsc (__func__);
 	
-	if (ht->table)
-		free (ht->table);
+	if (ht->ctrl_alloc)
+		free (ht->ctrl_alloc);
+	if (ht->key)
+		free (ht->key);
+	if (ht->data)
+		free (ht->data);
+	
+	if (ht->old_ht)
+	{
+		HashTable_u64_free (ht->old_ht);
+		free (ht->old_ht);
+	}
 	
 	HashTable_u64_preinit (ht);
 }
 
+static __force_inline int HashTable_u64_int_slot_used (const HashTable_u64 *ht, u64 entry_ix)
+{
+	if (ht->epoch)
+		return (ht->epoch [entry_ix] == ht->current_epoch);
+	else
+		return (ht->ctrl [entry_ix] != HASHTABLE_U64_EMPTY);
+}
+
 static __not_inline void HashTable_u64_clear (HashTable_u64 *ht)
 {
-	if (!ht || !ht->table)
+	if (!ht || !ht->ctrl)
 		return (void) ffsc (__func__);
 	
 	ht->used_capacity = 0;
 	ht->failed_reallocation = FALSE;
 	
-	u64 entry_ix;
-	for (entry_ix = 0; entry_ix < ht->total_capacity; entry_ix++)
+	if (ht->old_ht)
 	{
-		ht->table [entry_ix].key = 0;
-		ht->table [entry_ix].data = 0;
+		HashTable_u64_free (ht->old_ht);
+		free (ht->old_ht);
+		ht->old_ht = NULL;
+		ht->migrate_entry_ix = 0;
 	}
+	
+	// With epoch bytes, all slots become unused when current_epoch changes. The epoch bytes only have to be written when current_epoch wraps around
+	if (ht->epoch)
+	{
+		ht->current_epoch++;
+		if (ht->current_epoch != 0)
+			return;
+		
+		memset (ht->epoch, 0, ht->total_capacity);
+		ht->current_epoch = 1;
+		return;
+	}
+	
+	// Key and data of empty slots are never read, so only the control bytes need to be cleared
+	memset (ht->ctrl, HASHTABLE_U64_EMPTY, ht->total_capacity);
 }
 
 static __not_inline int HashTable_u64_allocate (HashTable_u64 *ht, u64 capacity)
 {
-	if (!ht || ht->table != NULL || bit_count_u64 (capacity) != 1)
+	if (!ht || ht->ctrl != NULL || bit_count_u64 (capacity) != 1)
 		return ffsc (__func__);
 	
-	ht->table = malloc (capacity * sizeof (HashTable_u64_entry));
-	if (!ht->table)
+	capacity = higher_of_u64 (capacity, HASHTABLE_U64_GROUP_SIZE);
+	
+	// The epoch bytes are put directly after the control bytes in the same allocation
+	u64 ctrl_size = ((ht->options & HASHTABLE_U64_EPOCH_CLEAR) ? 2 * capacity : capacity);
+	if (!allocate_aligned (ctrl_size, MAX_SUPPORTED_VECTOR_BYTE_SIZE, 0, FALSE, &ht->ctrl_alloc, (void **) &ht->ctrl))
 		return FALSE;
 	
+	if (ht->options & HASHTABLE_U64_EPOCH_CLEAR)
+	{
+		ht->epoch = ht->ctrl + capacity;
+		memset (ht->epoch, 0, capacity);
+		ht->current_epoch = 0;
+	}
+	
+	ht->key = malloc (capacity * sizeof (u64));
+	if (!ht->key)
+		return FALSE;
+	
+	if (!(ht->options & HASHTABLE_U64_KEYS_ONLY))
+	{
+		ht->data = malloc (capacity * sizeof (u64));
+		if (!ht->data)
+			return FALSE;
+	}
+	
 	ht->total_capacity = capacity;
 	ht->reallocate_capacity = (u64) (ht->reallocate_filled_part * (double) capacity);
 	ht->fail_capacity = (u64) (ht->fail_filled_part * (double) capacity);
@@ -76,18 +249,20 @@ static __not_inline int HashTable_u64_allocate (HashTable_u64 *ht, u64 capacity)
 	return TRUE;
 }
 
-static __not_inline int HashTable_u64_create (HashTable_u64 *ht, u64 first_capacity, double reallocate_filled_part, double fail_filled_part)
+static __not_inline int HashTable_u64_create (HashTable_u64 *ht, u64 first_capacity, double reallocate_filled_part, double fail_filled_part, u32 options)
 {
 	if (!ht)
 		return ffsc (__func__);
 	
 	HashTable_u64_preinit (ht);
 	
-	if (reallocate_filled_part < 0.25 || reallocate_filled_part > 1.0 || fail_filled_part < 0.25 || fail_filled_part > 1.0 || fail_filled_part < reallocate_filled_part)
+	if (reallocate_filled_part < 0.25 || reallocate_filled_part > 1.0 || fail_filled_part < 0.25 || fail_filled_part > 1.0 || fail_filled_part < reallocate_filled_part ||
+			(options & ~(HASHTABLE_U64_KEYS_ONLY | HASHTABLE_U64_EPOCH_CLEAR | HASHTABLE_U64_INCREMENTAL_RESIZE)) != 0)
 		return ffsc (__func__);
 	
 	ht->reallocate_filled_part = reallocate_filled_part;
 	ht->fail_filled_part = fail_filled_part;
+	ht->options = options;
 	
 	if (!HashTable_u64_allocate (ht, first_capacity))
 	{
@@ -99,36 +274,119 @@ static __not_inline int HashTable_u64_create (HashTable_u64 *ht, u64 first_capac
 	return TRUE;
 }
 
-static __force_inline int HashTable_u64_store (HashTable_u64 *ht, u64 key, u64 data, int replace_previous_data, int *was_present);
+// Moves the used entries in slots first_entry_ix to end_entry_ix - 1 of src_ht to dst_ht, which must not already contain any of the keys
+static __force_inline void HashTable_u64_int_move_entries (const HashTable_u64 *src_ht, u64 first_entry_ix, u64 end_entry_ix, HashTable_u64 *dst_ht)
+{
+	// There are no duplicate keys, so each one can be put directly in the first free slot
+	u64 entry_ix;
+	for (entry_ix = first_entry_ix; entry_ix < end_entry_ix; entry_ix++)
+		if (HashTable_u64_int_slot_used (src_ht, entry_ix))
+		{
+			u64 new_entry_ix;
+			HashTable_u64_int_find (dst_ht, src_ht->key [entry_ix], &new_entry_ix);
+			
+			dst_ht->ctrl [new_entry_ix] = src_ht->ctrl [entry_ix];
+			if (dst_ht->epoch)
+				dst_ht->epoch [new_entry_ix] = dst_ht->current_epoch;
+			dst_ht->key [new_entry_ix] = src_ht->key [entry_ix];
+			if (dst_ht->data)
+				dst_ht->data [new_entry_ix] = src_ht->data [entry_ix];
+		}
+}
+
+// Moves the entries of the next entry_cnt slots of old_ht to the current slots, and frees old_ht when all entries have been moved
+static __not_inline void HashTable_u64_int_migrate (HashTable_u64 *ht, u64 entry_cnt)
+{
+	HashTable_u64 *old_ht = ht->old_ht;
+	u64 end_entry_ix = lower_of_u64 (ht->migrate_entry_ix + entry_cnt, old_ht->total_capacity);
+	
+	HashTable_u64_int_move_entries (old_ht, ht->migrate_entry_ix, end_entry_ix, ht);
+	ht->migrate_entry_ix = end_entry_ix;
+	
+	if (end_entry_ix == old_ht->total_capacity)
+	{
+		HashTable_u64_free (old_ht);
+		free (old_ht);
+		ht->old_ht = NULL;
+		ht->migrate_entry_ix = 0;
+	}
+}
+
 static __not_inline int HashTable_u64_reallocate (HashTable_u64 *ht, u64 new_capacity)
 {
-	if (!ht || !ht->table || new_capacity <= ht->total_capacity)
+	if (!ht || !ht->ctrl || new_capacity <= ht->total_capacity)
 		return ffsc (__func__);
 	
+	// Only one set of old slots is kept, so an unfinished migration must be completed first
+	if (ht->old_ht)
+		HashTable_u64_int_migrate (ht, ht->old_ht->total_capacity);
+	
 	HashTable_u64 temp_ht;
 	HashTable_u64_preinit (&temp_ht);
 	temp_ht.reallocate_filled_part = ht->reallocate_filled_part;
 	temp_ht.fail_filled_part = ht->fail_filled_part;
+	temp_ht.options = ht->options;
 	
 	ht->failed_reallocation = !(HashTable_u64_allocate (&temp_ht, new_capacity));
 	if (ht->failed_reallocation)
+	{
+		HashTable_u64_free (&temp_ht);
 		return FALSE;
+	}
 	
-	u64 entry_ix;
-	for (entry_ix = 0; entry_ix < ht->total_capacity; entry_ix++)
+	temp_ht.used_capacity = ht->used_capacity;
+	
+	if (ht->options & HASHTABLE_U64_INCREMENTAL_RESIZE)
 	{
-		u64 entry_key = ht->table [entry_ix].key;
-		if (entry_key != 0)
-			HashTable_u64_store (&temp_ht, entry_key, ht->table [entry_ix].data, TRUE, NULL);
+		temp_ht.old_ht = malloc (sizeof (HashTable_u64));
+		ht->failed_reallocation = (temp_ht.old_ht == NULL);
+		if (ht->failed_reallocation)
+		{
+			HashTable_u64_free (&temp_ht);
+			return FALSE;
+		}
+		
+		*temp_ht.old_ht = *ht;
+		*ht = temp_ht;
+		
+		return TRUE;
 	}
 	
-	ht->total_capacity = temp_ht.total_capacity;
-	ht->reallocate_capacity = temp_ht.reallocate_capacity;
-	ht->fail_capacity = temp_ht.fail_capacity;
-	ht->used_capacity = temp_ht.used_capacity;
+	HashTable_u64_int_move_entries (ht, 0, ht->total_capacity, &temp_ht);
 	
-	free (ht->table);
-	ht->table = temp_ht.table;
+	HashTable_u64_free (ht);
+	*ht = temp_ht;
+	
+	return TRUE;
+}
+
+// Makes the table large enough to hold entry_cnt entries without growing. This is best done right after the table is created, when there are no entries to move
+static __not_inline int HashTable_u64_reserve (HashTable_u64 *ht, u64 entry_cnt)
+{
+	if (!ht || !ht->ctrl)
+		return ffsc (__func__);
+	
+	u64 new_capacity = ht->total_capacity;
+	while ((double) entry_cnt >= ht->reallocate_filled_part * (double) new_capacity)
+	{
+		if (new_capacity >= (((u64) 1) << 48))
+			return FALSE;
+		
+		new_capacity *= 2;
+	}
+	
+	if (new_capacity == ht->total_capacity)
+		return TRUE;
+	
+	if (!HashTable_u64_reallocate (ht, new_capacity))
+	{
+		// The table can still grow normally later
+		ht->failed_reallocation = FALSE;
+		return FALSE;
+	}
+	
+	if (ht->old_ht)
+		HashTable_u64_int_migrate (ht, ht->old_ht->total_capacity);
 	
 	return TRUE;
 }
@@ -138,24 +396,49 @@ static __force_inline int HashTable_u64_get_data (const HashTable_u64 *ht, u64 k
 	if (data)
 		*data = 0;
 	
-	if (!ht || !ht->table || key == 0)
+	if (!ht || !ht->ctrl || key == 0)
 		return ffsc (__func__);
 	
-	u64 entry_ix = key & (ht->total_capacity - 1);
-	while (TRUE)
+	const HashTable_u64 *found_ht = ht;
+	
+	u64 entry_ix;
+	if (!HashTable_u64_int_find (ht, key, &entry_ix))
 	{
-		if (ht->table [entry_ix].key == key)
-		{
-			if (data)
-				*data = ht->table [entry_ix].data;
-			
-			return TRUE;
-		}
-		else if (ht->table [entry_ix].key == 0)
+		if (!ht->old_ht || !HashTable_u64_int_find (ht->old_ht, key, &entry_ix))
 			return FALSE;
 		
-		entry_ix = (entry_ix + 1) & (ht->total_capacity - 1);
+		found_ht = ht->old_ht;
+	}
+	
+	if (data && found_ht->data)
+		*data = found_ht->data [entry_ix];
+	
+	return TRUE;
+}
+
+// Looks up key_cnt keys like repeated calls to HashTable_u64_get_data, but starts loading the slots of all keys first, so that the cache misses overlap
+// found and data can be NULL
+static __not_inline int HashTable_u64_get_batch (const HashTable_u64 *ht, const u64 *key, int key_cnt, int *found, u64 *data)
+{
+	if (!ht || !ht->ctrl || !key || key_cnt < 0)
+		return ffsc (__func__);
+	
+	int key_ix;
+	for (key_ix = 0; key_ix < key_cnt; key_ix++)
+	{
+		HashTable_u64_int_prefetch (ht, key [key_ix]);
+		if (ht->old_ht)
+			HashTable_u64_int_prefetch (ht->old_ht, key [key_ix]);
+	}
+	
+	for (key_ix = 0; key_ix < key_cnt; key_ix++)
+	{
+		int key_found = HashTable_u64_get_data (ht, key [key_ix], (data ? &data [key_ix] : NULL));
+		if (found)
+			found [key_ix] = key_found;
 	}
+	
+	return TRUE;
 }
 
 static __not_inline u64 HashTable_u64_memory_size (const HashTable_u64 *ht)
@@ -163,17 +446,25 @@ static __not_inline u64 HashTable_u64_memory_size (const HashTable_u64 *ht)
 	if (!ht)
 		return ffsc (__func__);
 	
-	return ht->total_capacity * sizeof (HashTable_u64_entry);
+	u64 memory_size = ht->total_capacity * (sizeof (u8) + (ht->epoch ? sizeof (u8) : 0) + sizeof (u64) + (ht->data ? sizeof (u64) : 0));
+	if (ht->old_ht)
+		memory_size += HashTable_u64_memory_size (ht->old_ht);
+	
+	return memory_size;
 }
 
+// For a table created with HASHTABLE_U64_KEYS_ONLY, data must be 0
 static __force_inline int HashTable_u64_store (HashTable_u64 *ht, u64 key, u64 data, int replace_previous_data, int *was_present)
 {
 	if (was_present)
 		*was_present = FALSE;
 	
-	if (!ht || !ht->table || key == 0)
+	if (!ht || !ht->ctrl || key == 0 || (data != 0 && !ht->data))
 		return ffsc (__func__);
 	
+	if (ht->old_ht)
+		HashTable_u64_int_migrate (ht, HASHTABLE_U64_MIGRATE_GROUPS * HASHTABLE_U64_GROUP_SIZE);
+	
 	if (ht->used_capacity >= ht->reallocate_capacity && !ht->failed_reallocation)
 		HashTable_u64_reallocate (ht, 2 * ht->total_capacity);
 	
@@ -184,28 +475,90 @@ static __force_inline int HashTable_u64_store (HashTable_u64 *ht, u64 key, u64 d
 			return FALSE;
 		}
 	
-	u64 entry_ix = key & (ht->total_capacity - 1);
-	while (TRUE)
+	u64 entry_ix;
+	if (HashTable_u64_int_find (ht, key, &entry_ix))
 	{
-		if (ht->table [entry_ix].key == key)
-		{
-			if (replace_previous_data)
-				ht->table [entry_ix].data = data;
-			
-			if (was_present)
-				*was_present = TRUE;
-			
-			return TRUE;
-		}
-		else if (ht->table [entry_ix].key == 0)
+		if (replace_previous_data && ht->data)
+			ht->data [entry_ix] = data;
+		
+		if (was_present)
+			*was_present = TRUE;
+		
+		return TRUE;
+	}
+	
+	// A key that isn't in the current slots can still be in the part of old_ht that hasn't been moved yet
+	u64 old_entry_ix;
+	if (ht->old_ht && HashTable_u64_int_find (ht->old_ht, key, &old_entry_ix))
+	{
+		if (replace_previous_data && ht->old_ht->data)
+			ht->old_ht->data [old_entry_ix] = data;
+		
+		if (was_present)
+			*was_present = TRUE;
+		
+		return TRUE;
+	}
+	
+	ht->ctrl [entry_ix] = HashTable_u64_int_ctrl_value (key);
+	if (ht->epoch)
+		ht->epoch [entry_ix] = ht->current_epoch;
+	
+	ht->key [entry_ix] = key;
+	if (ht->data)
+		ht->data [entry_ix] = data;
+	
+	ht->used_capacity++;
+	return TRUE;
+}
+
+// Stores key_cnt keys without data, like repeated calls to HashTable_u64_store, but starts loading the slots of all keys first, so that the cache misses overlap
+// was_present can be NULL
+static __not_inline int HashTable_u64_store_batch (HashTable_u64 *ht, const u64 *key, int key_cnt, int *was_present)
+{
+	if (!ht || !ht->ctrl || !key || key_cnt < 0)
+		return ffsc (__func__);
+	
+	// Grow the table before prefetching, so that the loaded slots are the ones that are used
+	if (ht->used_capacity + (u64) key_cnt >= ht->reallocate_capacity && !ht->failed_reallocation)
+		HashTable_u64_reallocate (ht, 2 * ht->total_capacity);
+	
+	int key_ix;
+	for (key_ix = 0; key_ix < key_cnt; key_ix++)
+	{
+		HashTable_u64_int_prefetch (ht, key [key_ix]);
+		if (ht->old_ht)
+			HashTable_u64_int_prefetch (ht->old_ht, key [key_ix]);
+	}
+	
+	// Every key is handled even if storing one fails, so that all of was_present is set
+	int success = TRUE;
+	for (key_ix = 0; key_ix < key_cnt; key_ix++)
+		if (!HashTable_u64_store (ht, key [key_ix], 0, FALSE, (was_present ? &was_present [key_ix] : NULL)))
+			success = FALSE;
+	
+	return success;
+}
+
+// Iterates over the keys in the table, in slot order. *entry_ix must be 0 for the first call, and the function returns FALSE when there are no more keys
+// An unfinished migration from old_ht is completed first, so that all keys are in the current slots. The table must not be changed during the iteration
+static __not_inline int HashTable_u64_get_next_key (HashTable_u64 *ht, u64 *entry_ix, u64 *key)
+{
+	if (!ht || !ht->ctrl || !entry_ix || !key)
+		return ffsc (__func__);
+	
+	if (ht->old_ht)
+		HashTable_u64_int_migrate (ht, ht->old_ht->total_capacity);
+	
+	while (*entry_ix < ht->total_capacity)
+	{
+		u64 slot_ix = (*entry_ix)++;
+		if (HashTable_u64_int_slot_used (ht, slot_ix))
 		{
-			ht->table [entry_ix].key = key;
-			ht->table [entry_ix].data = data;
-			
-			ht->used_capacity++;
+			*key = ht->key [slot_ix];
 			return TRUE;
 		}
-		
-		entry_ix = (entry_ix + 1) & (ht->total_capacity - 1);
 	}
+	
+	return FALSE;
 }
@@ -0,0 +1,239 @@
+// Low overhead timing and counters for the phases of a program. Time is measured in ticks of the time stamp counter where it is available, and otherwise in nanoseconds
+// of the monotonic clock. The ticks are converted to seconds with a rate measured over the whole run, so that no calibration is needed at startup
+// Phases are entered and left in a stack-like way, and each tick is charged to the innermost phase that was entered, so the time of a phase doesn't include the time of
+// the phases entered within it, and the times of all phases add up to the total time. Phase 0 is the base phase, which gets all time outside other phases
+// The number of bytes touched by a phase is not measured, but added by the caller as an estimate. Counters are plain sums, also added by the caller
+// Totals are kept for the whole run, and a copy of them is taken at the start of each round, so that each report can show both the round and the cumulative values
+
+#define INSTRUMENT_MAX_PHASES 32
+#define INSTRUMENT_MAX_COUNTERS 32
+#define INSTRUMENT_MAX_DEPTH 16
+
+typedef struct
+{
+	u64 ticks [INSTRUMENT_MAX_PHASES];
+	u64 calls [INSTRUMENT_MAX_PHASES];
+	u64 bytes [INSTRUMENT_MAX_PHASES];
+	u64 counter [INSTRUMENT_MAX_COUNTERS];
+	u64 tick;
+	double seconds;
+} InstrumentTotals;
+
+typedef struct
+{
+	int phase_cnt;
+	const char *const *phase_name;
+	int counter_cnt;
+	const char *const *counter_name;
+	int depth;
+	int phase_stack [INSTRUMENT_MAX_DEPTH];
+	u64 last_tick;
+	InstrumentTotals start;
+	InstrumentTotals round_start;
+	InstrumentTotals total;
+	FILE *json_file;
+} Instrument;
+
+static __force_inline u64 Instrument_get_tick (void)
+{
+	#if defined (__SSE2__) && (defined (__x86_64__) || defined (__i386__))
+		return __rdtsc ();
+	#else
+		#if defined (CLOCK_MONOTONIC) && !defined (_WIN32)
+			struct timespec ts;
+			clock_gettime (CLOCK_MONOTONIC, &ts);
+			return (1000000000u * (u64) ts.tv_sec) + (u64) ts.tv_nsec;
+		#else
+			return (u64) clock ();
+		#endif
+	#endif
+}
+
+static __not_inline void Instrument_int_take_totals (Instrument *ins, InstrumentTotals *totals)
+{
+	u64 now = Instrument_get_tick ();
+	ins->total.ticks [ins->phase_stack [ins->depth]] += now - ins->last_tick;
+	ins->last_tick = now;
+	
+	ins->total.tick = now;
+	ins->total.seconds = get_wall_seconds ();
+	*totals = ins->total;
+}
+
+static __may_inline void Instrument_preinit (Instrument *ins)
+{
+	if (!ins)
+		return (void) ffsc (__func__);
+	
+	ins->phase_cnt = 0;
+	ins->phase_name = NULL;
+	ins->counter_cnt = 0;
+	ins->counter_name = NULL;
+	ins->depth = 0;
+	ins->phase_stack [0] = 0;
+	ins->last_tick = 0;
+	memset (&ins->start, 0, sizeof (InstrumentTotals));
+	memset (&ins->round_start, 0, sizeof (InstrumentTotals));
+	memset (&ins->total, 0, sizeof (InstrumentTotals));
+	ins->json_file = NULL;
+}
+
+static __may_inline void Instrument_free (Instrument *ins)
+{
+	if (!ins)
+		return (void) ffsc (__func__);
+	
+	if (ins->json_file)
+		fclose (ins->json_file);
+	
+	Instrument_preinit (ins);
+}
+
+// The name arrays must stay valid while the Instrument is used. If json_filename is not NULL, each report is also written to that file, as one JSON object per line
+static __not_inline int Instrument_create (Instrument *ins, const char *const *phase_name, int phase_cnt, const char *const *counter_name, int counter_cnt,
+		const char *json_filename)
+{
+	if (!ins)
+		return ffsc (__func__);
+	
+	Instrument_preinit (ins);
+	
+	if (!phase_name || phase_cnt < 1 || phase_cnt > INSTRUMENT_MAX_PHASES || (counter_cnt != 0 && !counter_name) || counter_cnt < 0 ||
+			counter_cnt > INSTRUMENT_MAX_COUNTERS)
+		return ffsc (__func__);
+	
+	if (json_filename)
+	{
+		ins->json_file = fopen (json_filename, "w");
+		if (!ins->json_file)
+		{
+			fprintf (stderr, "Failed to open instrumentation file %s\n", json_filename);
+			return FALSE;
+		}
+	}
+	
+	ins->phase_cnt = phase_cnt;
+	ins->phase_name = phase_name;
+	ins->counter_cnt = counter_cnt;
+	ins->counter_name = counter_name;
+	
+	ins->last_tick = Instrument_get_tick ();
+	Instrument_int_take_totals (ins, &ins->start);
+	ins->round_start = ins->start;
+	
+	return TRUE;
+}
+
+static __force_inline void Instrument_enter (Instrument *ins, int phase)
+{
+	u64 now = Instrument_get_tick ();
+	ins->total.ticks [ins->phase_stack [ins->depth]] += now - ins->last_tick;
+	ins->last_tick = now;
+	
+	if (ins->depth < INSTRUMENT_MAX_DEPTH - 1)
+		ins->depth++;
+	
+	ins->phase_stack [ins->depth] = phase;
+	ins->total.calls [phase]++;
+}
+
+static __force_inline void Instrument_leave (Instrument *ins)
+{
+	u64 now = Instrument_get_tick ();
+	ins->total.ticks [ins->phase_stack [ins->depth]] += now - ins->last_tick;
+	ins->last_tick = now;
+	
+	if (ins->depth > 0)
+		ins->depth--;
+}
+
+static __force_inline void Instrument_add_bytes (Instrument *ins, int phase, u64 byte_cnt)
+{
+	ins->total.bytes [phase] += byte_cnt;
+}
+
+static __force_inline void Instrument_count (Instrument *ins, int counter, u64 value)
+{
+	ins->total.counter [counter] += value;
+}
+
+static __not_inline void Instrument_start_round (Instrument *ins)
+{
+	if (!ins)
+		return (void) ffsc (__func__);
+	
+	Instrument_int_take_totals (ins, &ins->round_start);
+}
+
+static double Instrument_int_seconds_per_tick (const InstrumentTotals *now, const InstrumentTotals *start)
+{
+	if (now->tick == start->tick)
+		return 0.0;
+	
+	return (now->seconds - start->seconds) / (double) (now->tick - start->tick);
+}
+
+static void Instrument_int_print_text (const Instrument *ins, const InstrumentTotals *now, const InstrumentTotals *from, double seconds_per_tick, int is_cumulative)
+{
+	double seconds = now->seconds - from->seconds;
+	
+	fprintf (stderr, "%-28s %10s %6s %12s %10s\n", (is_cumulative ? "cumulative" : "round"), "seconds", "%", "calls", "MB touched");
+	
+	int phase_ix;
+	for (phase_ix = 0; phase_ix < ins->phase_cnt; phase_ix++)
+	{
+		double phase_seconds = seconds_per_tick * (double) (now->ticks [phase_ix] - from->ticks [phase_ix]);
+		fprintf (stderr, "%-28s %10.3f %6.1f %12" PRIu64 " %10.1f\n", ins->phase_name [phase_ix], phase_seconds, (seconds > 0.0 ? 100.0 * phase_seconds / seconds : 0.0),
+				now->calls [phase_ix] - from->calls [phase_ix], (double) (now->bytes [phase_ix] - from->bytes [phase_ix]) / 1048576.0);
+	}
+	
+	int counter_ix;
+	for (counter_ix = 0; counter_ix < ins->counter_cnt; counter_ix++)
+		fprintf (stderr, "%-28s %12" PRIu64 "\n", ins->counter_name [counter_ix], now->counter [counter_ix] - from->counter [counter_ix]);
+}
+
+static void Instrument_int_print_json (const Instrument *ins, const InstrumentTotals *now, const InstrumentTotals *from, double seconds_per_tick)
+{
+	fprintf (ins->json_file, "{\"seconds\":%.6f,\"phases\":{", now->seconds - from->seconds);
+	
+	int phase_ix;
+	for (phase_ix = 0; phase_ix < ins->phase_cnt; phase_ix++)
+		fprintf (ins->json_file, "%s\"%s\":{\"seconds\":%.6f,\"calls\":%" PRIu64 ",\"bytes\":%" PRIu64 "}", (phase_ix == 0 ? "" : ","), ins->phase_name [phase_ix],
+				seconds_per_tick * (double) (now->ticks [phase_ix] - from->ticks [phase_ix]), now->calls [phase_ix] - from->calls [phase_ix],
+				now->bytes [phase_ix] - from->bytes [phase_ix]);
+	
+	fprintf (ins->json_file, "},\"counters\":{");
+	
+	int counter_ix;
+	for (counter_ix = 0; counter_ix < ins->counter_cnt; counter_ix++)
+		fprintf (ins->json_file, "%s\"%s\":%" PRIu64, (counter_ix == 0 ? "" : ","), ins->counter_name [counter_ix], now->counter [counter_ix] - from->counter [counter_ix]);
+	
+	fprintf (ins->json_file, "}}");
+}
+
+// Prints the values since the last call to Instrument_start_round and since Instrument_create, as text to stderr and as a JSON line to json_file if there is one.
+// label is written to the JSON line as the value of "round", and should be a valid JSON value, for example a number or a quoted string
+static __not_inline void Instrument_report (Instrument *ins, const char *label)
+{
+	if (!ins || !label)
+		return (void) ffsc (__func__);
+	
+	InstrumentTotals now;
+	Instrument_int_take_totals (ins, &now);
+	
+	double seconds_per_tick = Instrument_int_seconds_per_tick (&now, &ins->start);
+	
+	fprintf (stderr, "Instrumentation, round %s:\n", label);
+	Instrument_int_print_text (ins, &now, &ins->round_start, seconds_per_tick, FALSE);
+	Instrument_int_print_text (ins, &now, &ins->start, seconds_per_tick, TRUE);
+	
+	if (ins->json_file)
+	{
+		fprintf (ins->json_file, "{\"round\":%s,\"this_round\":", label);
+		Instrument_int_print_json (ins, &now, &ins->round_start, seconds_per_tick);
+		fprintf (ins->json_file, ",\"cumulative\":");
+		Instrument_int_print_json (ins, &now, &ins->start, seconds_per_tick);
+		fprintf (ins->json_file, "}\n");
+		fflush (ins->json_file);
+	}
+}
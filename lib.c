@@ -188,6 +188,16 @@ static __force_inline u64 higher_of_u64 (u64 arg1, u64 arg2)
 		return arg2;
 }
 
+// A hint to the CPU to start loading the cache line at address, when it is known to be needed soon
+static __force_inline void prefetch_read (const void *address)
+{
+	#ifdef __GNUC__
+		__builtin_prefetch (address, 0, 3);
+	#else
+		(void) address;
+	#endif
+}
+
 static __force_inline int bit_count_u64 (u64 arg)
 {
 	arg = (arg & 0x5555555555555555u) + ((arg >> 1) & 0x5555555555555555u);
@@ -317,6 +327,25 @@ static __force_inline u64 random_u64 (void)
 	return random_u64_state_1 + y;
 }
 
+// Processor time used by the program so far, in seconds. This only uses standard C, so it works with every compiler, but the resolution may be coarse
+static __not_inline double get_cpu_seconds (void)
+{
+	return (double) clock () / (double) CLOCKS_PER_SEC;
+}
+
+// Elapsed real time in seconds, from an arbitrary starting point. This uses the monotonic POSIX clock when the program is compiled with POSIX support, and processor
+// time otherwise, which is nearly the same for a program with a single thread
+static __not_inline double get_wall_seconds (void)
+{
+	#if defined (CLOCK_MONOTONIC) && !defined (_WIN32)
+		struct timespec ts;
+		if (clock_gettime (CLOCK_MONOTONIC, &ts) == 0)
+			return (double) ts.tv_sec + (1e-9 * (double) ts.tv_nsec);
+	#endif
+	
+	return get_cpu_seconds ();
+}
+
 static __not_inline void print_hex_u64 (char *text, u64 arg)
 {
 	printf ("%s%08x%08x\n", (text ? text : ""), (u32) (arg >> 32), (u32) arg);
@@ -1,2 +1,8 @@
 gcc destroy.c -lm -o destroy128.exe -std=c99 -O3 -Wall -Wextra -Wno-unused-function -Werror -fno-tree-loop-distribute-patterns -march=native -D __NO_AVX2
 gcc destroy.c -lm -o destroy256.exe -std=c99 -O3 -Wall -Wextra -Wno-unused-function -Werror -fno-tree-loop-distribute-patterns -march=native
+gcc bench_golgrid.c -lm -o bench_golgrid128.exe -std=c99 -O3 -Wall -Wextra -Wno-unused-function -Werror -fno-tree-loop-distribute-patterns -march=native -D __NO_AVX2
+gcc bench_golgrid.c -lm -o bench_golgrid256.exe -std=c99 -O3 -Wall -Wextra -Wno-unused-function -Werror -fno-tree-loop-distribute-patterns -march=native
+gcc bench_golgrid.c -lm -o bench_golgrid512.exe -std=c99 -O3 -Wall -Wextra -Wno-unused-function -Werror -fno-tree-loop-distribute-patterns -march=native -mavx512f -D __HAS_AVX_512F
+gcc bench_evolve.c -lm -o bench_evolve128.exe -std=c99 -O3 -Wall -Wextra -Wno-unused-function -Werror -fno-tree-loop-distribute-patterns -march=native -D __NO_AVX2
+gcc bench_evolve.c -lm -o bench_evolve256.exe -std=c99 -O3 -Wall -Wextra -Wno-unused-function -Werror -fno-tree-loop-distribute-patterns -march=native
+gcc bench_evolve.c -lm -o bench_evolve512.exe -std=c99 -O3 -Wall -Wextra -Wno-unused-function -Werror -fno-tree-loop-distribute-patterns -march=native -mavx512f -D __HAS_AVX_512F
@@ -0,0 +1,164 @@
+// Hardware performance counters of the CPU, read through perf_event_open on Linux. Each counter is opened on its own, for the calling thread in user mode only, so that
+// it works with the default setting of /proc/sys/kernel/perf_event_paranoid. Counters that can't be opened are marked as unavailable, which is the case for all of
+// them in many containers and virtual machines, and on other systems than Linux. The program should then work as usual, without the counter values
+// When there are more counters than the CPU can count at once, the kernel takes turns between them, and the values are scaled up to estimates for the whole time
+// There is no generic event for L2 cache misses, so only the L1 data cache and the last level cache are counted
+
+#ifdef __linux__
+	#include <linux/perf_event.h>
+	#include <sys/syscall.h>
+	#include <unistd.h>
+	#include <errno.h>
+#endif
+
+#define PERF_COUNTER_CYCLES 0
+#define PERF_COUNTER_INSTRUCTIONS 1
+#define PERF_COUNTER_L1D_MISSES 2
+#define PERF_COUNTER_LLC_MISSES 3
+#define PERF_COUNTER_BRANCH_MISSES 4
+#define PERF_COUNTER_CNT 5
+
+static const char *const perf_counter_name [PERF_COUNTER_CNT] = {"cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses"};
+
+typedef struct
+{
+	int fd [PERF_COUNTER_CNT];
+	int available_cnt;
+} PerfCounters;
+
+// A reading of all counters. The value of an unavailable counter is always 0
+typedef struct
+{
+	u64 value [PERF_COUNTER_CNT];
+} PerfCounterValues;
+
+static __may_inline void PerfCounters_preinit (PerfCounters *pc)
+{
+	if (!pc)
+		return (void) ffsc (__func__);
+	
+	int counter_ix;
+	for (counter_ix = 0; counter_ix < PERF_COUNTER_CNT; counter_ix++)
+		pc->fd [counter_ix] = -1;
+	
+	pc->available_cnt = 0;
+}
+
+static __may_inline void PerfCounters_free (PerfCounters *pc)
+{
+	if (!pc)
+		return (void) ffsc (__func__);
+	
+	#ifdef __linux__
+		int counter_ix;
+		for (counter_ix = 0; counter_ix < PERF_COUNTER_CNT; counter_ix++)
+			if (pc->fd [counter_ix] != -1)
+				close (pc->fd [counter_ix]);
+	#endif
+	
+	PerfCounters_preinit (pc);
+}
+
+#ifdef __linux__
+static int PerfCounters_int_open (u32 type, u64 config)
+{
+	struct perf_event_attr attr;
+	memset (&attr, 0, sizeof (attr));
+	
+	attr.type = type;
+	attr.size = sizeof (attr);
+	attr.config = config;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	
+	return (int) syscall (SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+// Opens and starts all counters that are available. This never fails, but if no counter is available and report_unavailable is TRUE, a note is printed to stderr
+static __not_inline void PerfCounters_create (PerfCounters *pc, int report_unavailable)
+{
+	if (!pc)
+		return (void) ffsc (__func__);
+	
+	PerfCounters_preinit (pc);
+	
+	#ifdef __linux__
+		u64 cache_read_miss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		
+		pc->fd [PERF_COUNTER_CYCLES] = PerfCounters_int_open (PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+		pc->fd [PERF_COUNTER_INSTRUCTIONS] = PerfCounters_int_open (PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+		pc->fd [PERF_COUNTER_L1D_MISSES] = PerfCounters_int_open (PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | cache_read_miss);
+		pc->fd [PERF_COUNTER_LLC_MISSES] = PerfCounters_int_open (PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | cache_read_miss);
+		pc->fd [PERF_COUNTER_BRANCH_MISSES] = PerfCounters_int_open (PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+		
+		int open_errno = errno;
+		
+		int counter_ix;
+		for (counter_ix = 0; counter_ix < PERF_COUNTER_CNT; counter_ix++)
+			if (pc->fd [counter_ix] != -1)
+				pc->available_cnt++;
+		
+		if (pc->available_cnt == 0 && report_unavailable)
+			fprintf (stderr, "Note: Hardware performance counters are not available (%s), see /proc/sys/kernel/perf_event_paranoid\n", strerror (open_errno));
+	#else
+		if (report_unavailable)
+			fprintf (stderr, "Note: Hardware performance counters are only supported on Linux\n");
+	#endif
+}
+
+static __force_inline int PerfCounters_is_available (const PerfCounters *pc, int counter_ix)
+{
+	return (pc->fd [counter_ix] != -1);
+}
+
+static __not_inline void PerfCounters_read (const PerfCounters *pc, PerfCounterValues *values)
+{
+	if (!pc || !values)
+		return (void) ffsc (__func__);
+	
+	int counter_ix;
+	for (counter_ix = 0; counter_ix < PERF_COUNTER_CNT; counter_ix++)
+	{
+		values->value [counter_ix] = 0;
+		
+		#ifdef __linux__
+			// The value, the time the counter was enabled and the time it was actually counting
+			u64 reading [3];
+			if (pc->fd [counter_ix] != -1 && read (pc->fd [counter_ix], reading, sizeof (reading)) == (ssize_t) sizeof (reading) && reading [2] != 0)
+				values->value [counter_ix] = (reading [2] == reading [1] ? reading [0] : (u64) ((double) reading [0] * (double) reading [1] / (double) reading [2]));
+		#endif
+	}
+}
+
+// Prints the differences between two readings as key=value pairs, followed by instructions per cycle and the number of each kind of miss per work_unit. Values
+// that can't be calculated are printed as "na"
+static void PerfCounters_print_delta (FILE *stream, const PerfCounters *pc, const PerfCounterValues *start, const PerfCounterValues *end, const char *work_unit,
+		u64 work_unit_cnt)
+{
+	int counter_ix;
+	for (counter_ix = 0; counter_ix < PERF_COUNTER_CNT; counter_ix++)
+	{
+		if (PerfCounters_is_available (pc, counter_ix))
+			fprintf (stream, " %s=%" PRIu64, perf_counter_name [counter_ix], end->value [counter_ix] - start->value [counter_ix]);
+		else
+			fprintf (stream, " %s=na", perf_counter_name [counter_ix]);
+	}
+	
+	u64 cycles = end->value [PERF_COUNTER_CYCLES] - start->value [PERF_COUNTER_CYCLES];
+	u64 instructions = end->value [PERF_COUNTER_INSTRUCTIONS] - start->value [PERF_COUNTER_INSTRUCTIONS];
+	
+	if (PerfCounters_is_available (pc, PERF_COUNTER_CYCLES) && PerfCounters_is_available (pc, PERF_COUNTER_INSTRUCTIONS) && cycles != 0)
+		fprintf (stream, " ipc=%.2f", (double) instructions / (double) cycles);
+	else
+		fprintf (stream, " ipc=na");
+	
+	for (counter_ix = PERF_COUNTER_L1D_MISSES; counter_ix < PERF_COUNTER_CNT; counter_ix++)
+	{
+		if (PerfCounters_is_available (pc, counter_ix) && work_unit_cnt != 0)
+			fprintf (stream, " %s_per_%s=%.3f", perf_counter_name [counter_ix], work_unit, (double) (end->value [counter_ix] - start->value [counter_ix]) / (double) work_unit_cnt);
+		else
+			fprintf (stream, " %s_per_%s=na", perf_counter_name [counter_ix], work_unit);
+	}
+}
@@ -1,10 +1,26 @@
 #define BYTE_SEQ_STORE_MIN_NODE_DATA_SIZE 4
 #define BYTE_SEQ_STORE_MAX_BYTE_SEQ_SIZE 0x0000ffff
+#define BYTE_SEQ_STORE_SPILL_BUFFER_SIZE 0x00100000
+
+// A store can be set to spill to a temporary file once its nodes use more than max_resident_memory bytes. After that, each node that gets full is written to the file
+// and replaced in the list by a node header with a spill_offset but no data, and the memory of the full node is reused for the next node. The file is written
+// and read through a large stdio buffer, and the operating system writes it back to disk in the background
+// Spilled nodes are read back one at a time into read_node when they are reached by ByteSeqStore_get_next
+typedef struct
+{
+	FILE *file;
+	s64 file_size;
+	s64 max_resident_memory;
+	int last_op_was_read;
+	const void *loaded_node;
+	void *read_node;
+} ByteSeqStoreSpill;
 
 typedef struct _ByteSeqStoreNode ByteSeqStoreNode;
 typedef struct _ByteSeqStoreNode
 {
 	ByteSeqStoreNode *next_node;
+	s64 spill_offset;
 	s32 used_size;
 	u8 data [];
 } ByteSeqStoreNode;
@@ -12,10 +28,15 @@ typedef struct _ByteSeqStoreNode
 typedef struct
 {
 	ByteSeqStoreNode *first_node;
+	ByteSeqStoreNode *before_last_node;
 	ByteSeqStoreNode *last_node;
+	ByteSeqStoreNode *free_node;
+	s64 free_node_cnt;
 	s32 node_data_size;
 	s64 memory_usage;
+	s64 spilled_size;
 	s64 seq_count;
+	ByteSeqStoreSpill *spill;
 } ByteSeqStore;
 
 static __may_inline void ByteSeqStore_preinit (ByteSeqStore *bss)
@@ -24,10 +45,15 @@ static __may_inline void ByteSeqStore_preinit (ByteSeqStore *bss)
 		return (void) ffsc (__func__);
 	
 	bss->first_node = NULL;
+	bss->before_last_node = NULL;
 	bss->last_node = NULL;
+	bss->free_node = NULL;
+	bss->free_node_cnt = 0;
 	bss->node_data_size = 0;
 	bss->memory_usage = 0;
+	bss->spilled_size = 0;
 	bss->seq_count = 0;
+	bss->spill = NULL;
 }
 
 static __not_inline void ByteSeqStore_free (ByteSeqStore *bss)
@@ -42,6 +68,23 @@ static __not_inline void ByteSeqStore_free (ByteSeqStore *bss)
 		free (del_node);
 	}
 	
+	while (bss->free_node)
+	{
+		ByteSeqStoreNode *del_node = bss->free_node;
+		bss->free_node = del_node->next_node;
+		free (del_node);
+	}
+	
+	if (bss->spill)
+	{
+		if (bss->spill->file)
+			fclose (bss->spill->file);
+		if (bss->spill->read_node)
+			free (bss->spill->read_node);
+		
+		free (bss->spill);
+	}
+	
 	ByteSeqStore_preinit (bss);
 }
 
@@ -55,6 +98,7 @@ static __not_inline ByteSeqStoreNode *ByteSeqStore_alloc_node (s32 node_size)
 	}
 	
 	new_node->next_node = NULL;
+	new_node->spill_offset = -1;
 	new_node->used_size = 0;
 	
 	return new_node;
@@ -82,23 +126,215 @@ static __not_inline int ByteSeqStore_create (ByteSeqStore *bss, s32 node_size)
 	return TRUE;
 }
 
+// The last node is kept as the first node, because it is always in memory even if the store has spilled. The other nodes are put in a list of free nodes that
+// are reused before any new node is allocated, so that a store which is cleared and refilled over and over doesn't have to allocate and free its nodes each time
+// The headers of spilled nodes are freed, as they have no data part
 static __not_inline void ByteSeqStore_clear (ByteSeqStore *bss)
 {
 	if (!bss || !bss->last_node)
 		return (void) ffsc (__func__);
 	
-	while (bss->first_node->next_node)
+	while (bss->first_node != bss->last_node)
 	{
-		ByteSeqStoreNode *del_node = bss->first_node->next_node;
-		bss->first_node->next_node = del_node->next_node;
-		free (del_node);
+		ByteSeqStoreNode *del_node = bss->first_node;
+		bss->first_node = del_node->next_node;
+		
+		if (del_node->spill_offset >= 0)
+			free (del_node);
+		else
+		{
+			del_node->next_node = bss->free_node;
+			bss->free_node = del_node;
+			bss->free_node_cnt++;
+		}
 	}
 	
-	bss->last_node = bss->first_node;
-	bss->memory_usage = ((s64) sizeof (ByteSeqStoreNode)) + (s64) bss->node_data_size;
+	bss->before_last_node = NULL;
+	bss->memory_usage = (((s64) sizeof (ByteSeqStoreNode)) + (s64) bss->node_data_size) * ((bss->spill ? 2 : 1) + bss->free_node_cnt);
+	bss->spilled_size = 0;
 	bss->seq_count = 0;
 	
 	bss->first_node->used_size = 0;
+	
+	if (bss->spill)
+	{
+		bss->spill->file_size = 0;
+		bss->spill->loaded_node = NULL;
+	}
+}
+
+// Frees the nodes that clear has kept for reuse
+static __not_inline void ByteSeqStore_release_free_nodes (ByteSeqStore *bss)
+{
+	if (!bss || !bss->last_node)
+		return (void) ffsc (__func__);
+	
+	while (bss->free_node)
+	{
+		ByteSeqStoreNode *del_node = bss->free_node;
+		bss->free_node = del_node->next_node;
+		free (del_node);
+	}
+	
+	bss->memory_usage -= (((s64) sizeof (ByteSeqStoreNode)) + (s64) bss->node_data_size) * bss->free_node_cnt;
+	bss->free_node_cnt = 0;
+}
+
+// Exchanges the contents of two stores, including their nodes, free nodes and spill files, without copying any byte sequences
+static __may_inline void ByteSeqStore_swap (ByteSeqStore *bss_1, ByteSeqStore *bss_2)
+{
+	if (!bss_1 || !bss_2)
+		return (void) ffsc (__func__);
+	
+	ByteSeqStore temp_bss = *bss_1;
+	*bss_1 = *bss_2;
+	*bss_2 = temp_bss;
+}
+
+// Makes the store spill to a temporary file when its nodes use more than max_resident_memory bytes. The store must be empty
+static __not_inline int ByteSeqStore_set_spill (ByteSeqStore *bss, s64 max_resident_memory)
+{
+	if (!bss || !bss->last_node || bss->spill || bss->seq_count != 0 || max_resident_memory <= 0)
+		return ffsc (__func__);
+	
+	bss->spill = malloc (sizeof (ByteSeqStoreSpill));
+	if (!bss->spill)
+	{
+		fprintf (stderr, "Out of memory in %s\n", __func__);
+		return FALSE;
+	}
+	
+	bss->spill->file = NULL;
+	bss->spill->file_size = 0;
+	bss->spill->max_resident_memory = max_resident_memory;
+	bss->spill->last_op_was_read = FALSE;
+	bss->spill->loaded_node = NULL;
+	bss->spill->read_node = ByteSeqStore_alloc_node ((s32) sizeof (ByteSeqStoreNode) + bss->node_data_size);
+	
+	bss->spill->file = tmpfile ();
+	if (!bss->spill->file || !bss->spill->read_node || setvbuf (bss->spill->file, NULL, _IOFBF, BYTE_SEQ_STORE_SPILL_BUFFER_SIZE) != 0)
+	{
+		fprintf (stderr, "Failed to create a temporary file in %s\n", __func__);
+		
+		if (bss->spill->file)
+			fclose (bss->spill->file);
+		if (bss->spill->read_node)
+			free (bss->spill->read_node);
+		
+		free (bss->spill);
+		bss->spill = NULL;
+		return FALSE;
+	}
+	
+	bss->memory_usage += ((s64) sizeof (ByteSeqStoreNode)) + (s64) bss->node_data_size;
+	return TRUE;
+}
+
+// Writes the full last node to the spill file, and puts a header without data in its place in the list. The memory of the last node is then reused as a new empty
+// last node. Returns FALSE if the node couldn't be written, and the store is then unchanged
+static __not_inline int ByteSeqStore_spill_last_node (ByteSeqStore *bss)
+{
+	ByteSeqStoreSpill *spill = bss->spill;
+	ByteSeqStoreNode *full_node = bss->last_node;
+	
+	// File offsets are passed to fseek as a long, which is only 32 bits on some platforms
+	if (spill->file_size > (s64) (LONG_MAX - full_node->used_size))
+		return FALSE;
+	
+	ByteSeqStoreNode *header_node = malloc (sizeof (ByteSeqStoreNode));
+	if (!header_node)
+		return FALSE;
+	
+	if (spill->last_op_was_read && fseek (spill->file, (long) spill->file_size, SEEK_SET) != 0)
+	{
+		free (header_node);
+		return FALSE;
+	}
+	
+	spill->last_op_was_read = FALSE;
+	
+	if (fwrite (full_node->data, 1, (size_t) full_node->used_size, spill->file) != (size_t) full_node->used_size)
+	{
+		fprintf (stderr, "Failed to write to the spill file in %s\n", __func__);
+		free (header_node);
+		return FALSE;
+	}
+	
+	header_node->next_node = full_node;
+	header_node->spill_offset = spill->file_size;
+	header_node->used_size = full_node->used_size;
+	
+	if (bss->before_last_node)
+		bss->before_last_node->next_node = header_node;
+	else
+		bss->first_node = header_node;
+	
+	spill->file_size += (s64) full_node->used_size;
+	bss->spilled_size += (s64) full_node->used_size;
+	bss->memory_usage += (s64) sizeof (ByteSeqStoreNode);
+	
+	bss->before_last_node = header_node;
+	full_node->used_size = 0;
+	
+	return TRUE;
+}
+
+// Reads the data of a spilled node into the read node of the store, unless it is already there
+static __not_inline const ByteSeqStoreNode *ByteSeqStore_load_spilled_node (const ByteSeqStore *bss, const ByteSeqStoreNode *header_node)
+{
+	ByteSeqStoreSpill *spill = bss->spill;
+	ByteSeqStoreNode *read_node = spill->read_node;
+	
+	if (spill->loaded_node == header_node)
+		return read_node;
+	
+	spill->loaded_node = NULL;
+	spill->last_op_was_read = TRUE;
+	
+	if (fseek (spill->file, (long) header_node->spill_offset, SEEK_SET) != 0 ||
+			fread (read_node->data, 1, (size_t) header_node->used_size, spill->file) != (size_t) header_node->used_size)
+	{
+		fprintf (stderr, "Failed to read from the spill file in %s\n", __func__);
+		return NULL;
+	}
+	
+	read_node->used_size = header_node->used_size;
+	spill->loaded_node = header_node;
+	
+	return read_node;
+}
+
+// Makes an empty last node. A free node is used if there is one, and otherwise the current last node is spilled if the store has reached its memory limit, or a new
+// node is allocated
+static __not_inline int ByteSeqStore_add_node (ByteSeqStore *bss)
+{
+	ByteSeqStoreNode *new_node = bss->free_node;
+	if (new_node)
+	{
+		bss->free_node = new_node->next_node;
+		bss->free_node_cnt--;
+		
+		new_node->next_node = NULL;
+		new_node->used_size = 0;
+	}
+	else
+	{
+		if (bss->spill && bss->memory_usage + (s64) sizeof (ByteSeqStoreNode) + (s64) bss->node_data_size > bss->spill->max_resident_memory)
+			if (ByteSeqStore_spill_last_node (bss))
+				return TRUE;
+		
+		new_node = ByteSeqStore_alloc_node ((s32) sizeof (ByteSeqStoreNode) + bss->node_data_size);
+		if (!new_node)
+			return FALSE;
+		
+		bss->memory_usage += ((s64) sizeof (ByteSeqStoreNode)) + (s64) bss->node_data_size;
+	}
+	
+	bss->last_node->next_node = new_node;
+	bss->before_last_node = bss->last_node;
+	bss->last_node = new_node;
+	
+	return TRUE;
 }
 
 static __force_inline int ByteSeqStore_store (ByteSeqStore *bss, const u8 *byte_seq, s32 seq_size)
@@ -111,15 +347,8 @@ static __force_inline int ByteSeqStore_store (ByteSeqStore *bss, const u8 *byte_
 		return ffsc (__func__);
 	
 	if (bss->last_node->used_size + needed_space > bss->node_data_size)
-	{
-		ByteSeqStoreNode *new_node = ByteSeqStore_alloc_node ((s32) sizeof (ByteSeqStoreNode) + bss->node_data_size);
-		if (!new_node)
+		if (!ByteSeqStore_add_node (bss))
 			return FALSE;
-		
-		bss->last_node->next_node = new_node;
-		bss->last_node = new_node;
-		bss->memory_usage += ((s64) sizeof (ByteSeqStoreNode)) + (s64) bss->node_data_size;
-	}
 	
 	bss->last_node->data [bss->last_node->used_size++] = seq_size >> 8;
 	bss->last_node->data [bss->last_node->used_size++] = seq_size & 0x00ffu;
@@ -147,8 +376,12 @@ static __not_inline void ByteSeqStore_start_get_iteration (const ByteSeqStore *b
 	*node_data_offset = 0;
 }
 
-static __force_inline int ByteSeqStore_get_next (const ByteSeqStore *bss, ByteSeqStoreNode **bss_node, s32 *node_data_offset, u8 *byte_seq, s32 max_seq_size, s32 *seq_size)
+// Like ByteSeqStore_get_next, but instead of copying the byte sequence it sets byte_seq to point at it inside the store. This pointer is valid until the store is
+// changed, or if the store has spilled, until the next call that reads a spilled node
+static __force_inline int ByteSeqStore_get_next_view (const ByteSeqStore *bss, ByteSeqStoreNode **bss_node, s32 *node_data_offset, const u8 **byte_seq, s32 *seq_size)
 {
+	if (byte_seq)
+		*byte_seq = NULL;
 	if (seq_size)
 		*seq_size = 0;
 	
@@ -167,22 +400,44 @@ static __force_inline int ByteSeqStore_get_next (const ByteSeqStore *bss, ByteSe
 			return FALSE;
 	}
 	
-	s32 size = (((s32) (*bss_node)->data [*node_data_offset]) << 8) | (s32) (*bss_node)->data [(*node_data_offset) + 1];
-	int success = TRUE;
-	
-	if (size > max_seq_size)
-		success = FALSE;
-	else
+	const ByteSeqStoreNode *data_node = *bss_node;
+	if (data_node->spill_offset >= 0)
 	{
-		if (seq_size)
-			*seq_size = size;
-		
-		s32 seq_ix;
-		for (seq_ix = 0; seq_ix < size; seq_ix++)
-			byte_seq [seq_ix] = (*bss_node)->data [(*node_data_offset) + (2 + seq_ix)];
+		data_node = ByteSeqStore_load_spilled_node (bss, data_node);
+		if (!data_node)
+			return FALSE;
 	}
 	
+	s32 size = (((s32) data_node->data [*node_data_offset]) << 8) | (s32) data_node->data [(*node_data_offset) + 1];
+	
+	*byte_seq = data_node->data + (*node_data_offset) + 2;
+	if (seq_size)
+		*seq_size = size;
+	
 	*node_data_offset += (2 + size);
 	
-	return success;
+	return TRUE;
+}
+
+static __force_inline int ByteSeqStore_get_next (const ByteSeqStore *bss, ByteSeqStoreNode **bss_node, s32 *node_data_offset, u8 *byte_seq, s32 max_seq_size, s32 *seq_size)
+{
+	if (seq_size)
+		*seq_size = 0;
+	
+	if (!bss || !bss->last_node || !bss_node || !node_data_offset || !byte_seq)
+		return ffsc (__func__);
+	
+	const u8 *view;
+	s32 size;
+	if (!ByteSeqStore_get_next_view (bss, bss_node, node_data_offset, &view, &size) || size > max_seq_size)
+		return FALSE;
+	
+	if (seq_size)
+		*seq_size = size;
+	
+	s32 seq_ix;
+	for (seq_ix = 0; seq_ix < size; seq_ix++)
+		byte_seq [seq_ix] = view [seq_ix];
+	
+	return TRUE;
 }
@@ -0,0 +1,156 @@
+// Writes spans of time to a file in the trace event format of Chrome and Perfetto, as a JSON array of complete events ("ph":"X"). Open the file in ui.perfetto.dev
+// or chrome://tracing to see them on a timeline
+// Spans are collected in a buffer of TRACE_BUFFER_EVENT_CNT events, and only formatted and written to the file when the buffer is full or the trace is closed, so that
+// adding a span is just a few stores. Each thread of a program should have its own Trace with its own thread id, all writing to separate files or taking turns
+// The file is still readable if the program ends without closing the trace, as the trace viewers accept an array without the closing bracket
+// Names and categories of spans are not copied, so they should be string literals
+
+#define TRACE_BUFFER_EVENT_CNT 4096
+
+typedef struct
+{
+	const char *name;
+	const char *category;
+	double start_time;
+	double end_time;
+	s64 arg;
+} TraceEvent;
+
+typedef struct
+{
+	FILE *file;
+	int thread_id;
+	double start_time;
+	s32 event_cnt;
+	s64 written_event_cnt;
+	u32 sample_mask;
+	u64 sample_cnt;
+	TraceEvent *event;
+} Trace;
+
+static __may_inline void Trace_preinit (Trace *tr)
+{
+	if (!tr)
+		return (void) ffsc (__func__);
+	
+	tr->file = NULL;
+	tr->thread_id = 0;
+	tr->start_time = 0.0;
+	tr->event_cnt = 0;
+	tr->written_event_cnt = 0;
+	tr->sample_mask = 0;
+	tr->sample_cnt = 0;
+	tr->event = NULL;
+}
+
+static __not_inline void Trace_flush (Trace *tr)
+{
+	if (!tr)
+		return (void) ffsc (__func__);
+	
+	if (!tr->file)
+		return;
+	
+	s32 event_ix;
+	for (event_ix = 0; event_ix < tr->event_cnt; event_ix++)
+	{
+		const TraceEvent *ev = &tr->event [event_ix];
+		
+		// Timestamps are in microseconds since the trace was created
+		fprintf (tr->file, "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"ix\":%" PRId64 "}}",
+				(tr->written_event_cnt == 0 ? "" : ","), ev->name, ev->category, 1e6 * (ev->start_time - tr->start_time), 1e6 * (ev->end_time - ev->start_time),
+				tr->thread_id, ev->arg);
+		
+		tr->written_event_cnt++;
+	}
+	
+	tr->event_cnt = 0;
+	fflush (tr->file);
+}
+
+// Writes the remaining spans and ends the JSON array
+static __may_inline void Trace_free (Trace *tr)
+{
+	if (!tr)
+		return (void) ffsc (__func__);
+	
+	if (tr->file)
+	{
+		Trace_flush (tr);
+		fprintf (tr->file, "\n]\n");
+		fclose (tr->file);
+	}
+	
+	if (tr->event)
+		free (tr->event);
+	
+	Trace_preinit (tr);
+}
+
+// Only one of every sample_interval calls to Trace_sample returns TRUE, which is used to trace only some of the spans that are too frequent to trace them all
+// sample_interval must be a power of two
+static __not_inline int Trace_create (Trace *tr, const char *filename, int thread_id, u32 sample_interval)
+{
+	if (!tr)
+		return ffsc (__func__);
+	
+	Trace_preinit (tr);
+	
+	if (!filename || sample_interval == 0 || (sample_interval & (sample_interval - 1)) != 0)
+		return ffsc (__func__);
+	
+	tr->event = malloc (TRACE_BUFFER_EVENT_CNT * sizeof (TraceEvent));
+	if (!tr->event)
+	{
+		fprintf (stderr, "Out of memory in %s\n", __func__);
+		return FALSE;
+	}
+	
+	tr->file = fopen (filename, "w");
+	if (!tr->file)
+	{
+		fprintf (stderr, "Failed to open trace file %s\n", filename);
+		Trace_free (tr);
+		return FALSE;
+	}
+	
+	fprintf (tr->file, "[");
+	
+	tr->thread_id = thread_id;
+	tr->start_time = get_wall_seconds ();
+	tr->sample_mask = sample_interval - 1;
+	
+	return TRUE;
+}
+
+static __force_inline int Trace_is_on (const Trace *tr)
+{
+	return (tr->file != NULL);
+}
+
+// Returns the start time to pass to Trace_add_span, or 0.0 if the trace is off
+static __force_inline double Trace_start_span (const Trace *tr)
+{
+	return (tr->file ? get_wall_seconds () : 0.0);
+}
+
+static __force_inline int Trace_sample (Trace *tr)
+{
+	return (tr->file && ((tr->sample_cnt++) & tr->sample_mask) == 0);
+}
+
+static __force_inline void Trace_add_span (Trace *tr, const char *name, const char *category, double start_time, s64 arg)
+{
+	if (!tr->file)
+		return;
+	
+	if (tr->event_cnt == TRACE_BUFFER_EVENT_CNT)
+		Trace_flush (tr);
+	
+	TraceEvent *ev = &tr->event [tr->event_cnt++];
+	ev->name = name;
+	ev->category = category;
+	ev->start_time = start_time;
+	ev->end_time = get_wall_seconds ();
+	ev->arg = arg;
+}